@@ -1,4 +1,5 @@
 import json
+import struct
 import sys
 from typing import Any, Dict, List, Optional, Tuple
 
@@ -38,6 +39,9 @@ float_t = 10
 double_t = 11
 reference_t = 12
 
+# set on the type byte of a data frame whose column is nullable
+nullable_flag = 0x80
+
 def typeLength(type):
     if type == i8_t: return 1
     elif type == i16_t: return 2
@@ -95,11 +99,11 @@ def parseType(data: bytes, i, type, size) -> Tuple[int, List[Any]]:
     elif type == string_t: 
         raise NotImplementedError()
     elif type == boolean_t: 
-        raise NotImplementedError()
+        return e, [x != 0 for x in data[i:e]]
     elif type == float_t: 
-        raise NotImplementedError()
+        return e, list(struct.unpack_from(f'<{size}f', data, i))
     elif type == double_t: 
-        raise NotImplementedError()
+        return e, list(struct.unpack_from(f'<{size}d', data, i))
     elif type == reference_t: 
         raise RuntimeError('reference type not basicaly parsable')
     else: raise RuntimeError(f'Unknown type: {type}')
@@ -137,19 +141,106 @@ def parseResult(data, i = 0) -> Tuple[int, Any]:
         j, name = parseString(data, i + 1)
         j, type = parseU8(data, j)
         j, size = parseU64(data, j)
+        nullable = type & nullable_flag != 0
+        type &= ~nullable_flag
+        if nullable:
+            words = (size + 63) // 64
+            bitmap = memoryview(data)[j:j + 8 * words].cast('Q')
+            j += 8 * words
         j, elements = parseType(data, j, type, size)
-        return j + 1, { 'name': name, 'type': typeName(type), 'size': size, 'elements': elements }
+        if nullable:
+            elements = [x if bitmap[k >> 6] >> (k & 63) & 1 else None for k, x in enumerate(elements)]
+        return j + 1, { 'name': name, 'type': typeName(type), 'size': size, 'nullable': nullable, 'elements': elements }
     elif data[i] == startReferenceAttribute:
         raise NotImplementedError()
     else:
         raise RuntimeError(f'Unexpected byte: {data[i]}')
 
+columnarMagic = b'NITROCOL'
+
+# struct format of each type's values in the columnar layout
+def typeFormat(type):
+    if type == i8_t: return 'b'
+    elif type == i16_t: return 'h'
+    elif type == i32_t: return 'i'
+    elif type == i64_t: return 'q'
+    elif type == u8_t: return 'B'
+    elif type == u16_t: return 'H'
+    elif type == u32_t: return 'I'
+    elif type == u64_t: return 'Q'
+    elif type == boolean_t: return '?'
+    elif type == float_t: return 'f'
+    elif type == double_t: return 'd'
+    elif type == reference_t: return 'Q'
+    else: raise RuntimeError(f'No columnar format for type: {type}')
+
+def readColumnar(data) -> List[Dict[str, Any]]:
+    """Views every column of a columnar payload without copying its buffers,
+    values are numpy arrays when numpy is available and memoryviews otherwise."""
+    try:
+        import numpy
+    except ImportError:
+        numpy = None
+
+    view = memoryview(data)
+    if bytes(view[0:8]) != columnarMagic:
+        raise RuntimeError('payload is not in the columnar layout')
+    version = int.from_bytes(view[8:12], 'little')
+    if version != 1:
+        raise RuntimeError(f'unsupported columnar version: {version}')
+    n = int.from_bytes(view[16:24], 'little')
+
+    columns = []
+    i = 64
+    for _ in range(n):
+        length = int.from_bytes(view[i:i + 8], 'little')
+        type = view[i + 8]
+        nullable = view[i + 9] & 1 != 0
+        tableLength = int.from_bytes(view[i + 10:i + 12], 'little')
+        columnLength = int.from_bytes(view[i + 12:i + 14], 'little')
+        size = int.from_bytes(view[i + 16:i + 24], 'little')
+        validityOffset = int.from_bytes(view[i + 24:i + 32], 'little')
+        valuesOffset = int.from_bytes(view[i + 32:i + 40], 'little')
+        valuesLength = int.from_bytes(view[i + 40:i + 48], 'little')
+        table = bytes(view[i + 48:i + 48 + tableLength]).decode('utf-8')
+        name = bytes(view[i + 48 + tableLength:i + 48 + tableLength + columnLength]).decode('utf-8')
+
+        format = typeFormat(type)
+        if numpy is not None:
+            values = numpy.frombuffer(data, dtype=numpy.dtype(format).newbyteorder('<'), count=size, offset=valuesOffset)
+        else:
+            values = view[valuesOffset:valuesOffset + valuesLength].cast(format)
+        validity = None
+        if nullable:
+            words = (size + 63) // 64
+            validity = view[validityOffset:validityOffset + 8 * words].cast('Q')
+
+        columns.append({ 'table': table, 'name': name, 'type': typeName(type), 'size': size, 'nullable': nullable, 'values': values, 'validity': validity })
+        i += length
+    return columns
+
+def columnElements(column: Dict[str, Any]) -> List[Any]:
+    values = column['values'].tolist()
+    if column['validity'] is None:
+        return values
+    validity = column['validity']
+    return [x if validity[k >> 6] >> (k & 63) & 1 else None for k, x in enumerate(values)]
+
 def readResult(filename: str, options: Dict[str, bool]):
     with open(filename, 'rb') as file:
         data = file.read()
 
     n = len(data)
 
+    if data.startswith(columnarMagic):
+        return {
+            **({ 'hex': data.hex() } if options.get('showHex', False) else {}),
+            'columns': [
+                { k: v for k, v in c.items() if k not in ('values', 'validity') } | { 'elements': columnElements(c) }
+                for c in readColumnar(data)
+            ]
+        }
+
     parsedResults = []
     j, parsedResult = parseResult(data)
     parsedResults.append(parsedResult)
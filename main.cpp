@@ -4,11 +4,32 @@
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
+#include <bit>
 #include <fstream>
+#include <sstream>
+#include <numeric>
 #include <iostream>
 #include <exception>
 #include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <deque>
+#include <thread>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
+#include <string_view>
+#include <random>
+#include <cmath>
+#include <optional>
+#include <queue>
+#include <limits>
+#include <utility>
 #include <string.h>
+#include <cstdlib>
 
 using byte = std::uint8_t;
 using bytes = std::vector<byte>;
@@ -31,41 +52,8 @@ enum class AttributeKind : byte {
     reference,
 };
 
-std::uint8_t attributeSize(AttributeKind k) {
-    switch (k)
-    {
-    case AttributeKind::i8:
-        return 1;
-    case AttributeKind::i16:
-        return 2;
-    case AttributeKind::i32:
-        return 4;
-    case AttributeKind::i64:
-        return 8;
-    case AttributeKind::u8:
-        return 1;
-    case AttributeKind::u16:
-        return 2;
-    case AttributeKind::u32:
-        return 4;
-    case AttributeKind::u64:
-        return 8;
-    case AttributeKind::string:
-        throw "todo";
-    case AttributeKind::boolean:
-        return 1;
-    case AttributeKind::float_:
-        return 4;
-    case AttributeKind::double_:
-        return 8;
-    case AttributeKind::reference:
-        return 4;
-    }
-    throw std::runtime_error("unhandled attr kind");
-}
-
 struct Attribute {
-    AttributeKind kind;
+    AttributeKind kind = AttributeKind::u64;
     union Attribute_ {
         std::int8_t i8;
         std::int16_t i16;
@@ -86,99 +74,89 @@ struct Attribute {
     } data;
 
     Attribute() = default;
+    Attribute(Attribute const& attr);
+    Attribute& operator=(Attribute const& attr);
+};
 
-    Attribute(Attribute const& attr) : kind(attr.kind) {
-        switch (kind)
-        {
-        case AttributeKind::i8:
-            data.i8 = attr.data.i8;
-            break;
-        case AttributeKind::i16:
-            data.i16 = attr.data.i16;
-            break;
-        case AttributeKind::i32:
-            data.i32 = attr.data.i32;
-            break;
-        case AttributeKind::i64:
-            data.i64 = attr.data.i64;
-            break;
-        case AttributeKind::u8:
-            data.u8 = attr.data.u8;
-            break;
-        case AttributeKind::u16:
-            data.u16 = attr.data.u16;
-            break;
-        case AttributeKind::u32:
-            data.u32 = attr.data.u32;
-            break;
-        case AttributeKind::u64:
-            data.u64 = attr.data.u64;
-            break;
-        case AttributeKind::string:
-            data.string = attr.data.string;
-            break;
-        case AttributeKind::boolean:
-            data.boolean = attr.data.boolean;
-            break;
-        case AttributeKind::float_:
-            data.float_ = attr.data.float_;
-            break;
-        case AttributeKind::double_:
-            data.double_ = attr.data.double_;
-            break;
-        case AttributeKind::reference:
-            data.reference = attr.data.reference;
-            break;
-        }
-    }
+// compile time description of every attribute kind: its C++ type, the union
+// member holding it, its on disk width and its name, kernels are written once
+// against these and instantiated per kind by dispatch
+template <AttributeKind K, typename T, T Attribute::Attribute_::* M, std::uint8_t S>
+struct KindTraitsOf {
+    using type = T;
+    static constexpr AttributeKind kind = K;
+    static constexpr auto member = M;
+    static constexpr std::uint8_t size = S;
+    static constexpr bool fixedWidth = S != 0;
+};
 
-    Attribute& operator=(Attribute const& attr) {
-        kind = attr.kind;
-        switch (kind)
-        {
-        case AttributeKind::i8:
-            data.i8 = attr.data.i8;
-            break;
-        case AttributeKind::i16:
-            data.i16 = attr.data.i16;
-            break;
-        case AttributeKind::i32:
-            data.i32 = attr.data.i32;
-            break;
-        case AttributeKind::i64:
-            data.i64 = attr.data.i64;
-            break;
-        case AttributeKind::u8:
-            data.u8 = attr.data.u8;
-            break;
-        case AttributeKind::u16:
-            data.u16 = attr.data.u16;
-            break;
-        case AttributeKind::u32:
-            data.u32 = attr.data.u32;
-            break;
-        case AttributeKind::u64:
-            data.u64 = attr.data.u64;
-            break;
-        case AttributeKind::string:
-            data.string = attr.data.string;
-            break;
-        case AttributeKind::boolean:
-            data.boolean = attr.data.boolean;
-            break;
-        case AttributeKind::float_:
-            data.float_ = attr.data.float_;
-            break;
-        case AttributeKind::double_:
-            data.double_ = attr.data.double_;
-            break;
-        case AttributeKind::reference:
-            data.reference = attr.data.reference;
-            break;
-        }
-        return *this;
+template <AttributeKind K> struct KindTraits;
+template <> struct KindTraits<AttributeKind::i8> : KindTraitsOf<AttributeKind::i8, std::int8_t, &Attribute::Attribute_::i8, 1> { static constexpr char const* name = "i8"; };
+template <> struct KindTraits<AttributeKind::i16> : KindTraitsOf<AttributeKind::i16, std::int16_t, &Attribute::Attribute_::i16, 2> { static constexpr char const* name = "i16"; };
+template <> struct KindTraits<AttributeKind::i32> : KindTraitsOf<AttributeKind::i32, std::int32_t, &Attribute::Attribute_::i32, 4> { static constexpr char const* name = "i32"; };
+template <> struct KindTraits<AttributeKind::i64> : KindTraitsOf<AttributeKind::i64, std::int64_t, &Attribute::Attribute_::i64, 8> { static constexpr char const* name = "i64"; };
+template <> struct KindTraits<AttributeKind::u8> : KindTraitsOf<AttributeKind::u8, std::uint8_t, &Attribute::Attribute_::u8, 1> { static constexpr char const* name = "u8"; };
+template <> struct KindTraits<AttributeKind::u16> : KindTraitsOf<AttributeKind::u16, std::uint16_t, &Attribute::Attribute_::u16, 2> { static constexpr char const* name = "u16"; };
+template <> struct KindTraits<AttributeKind::u32> : KindTraitsOf<AttributeKind::u32, std::uint32_t, &Attribute::Attribute_::u32, 4> { static constexpr char const* name = "u32"; };
+template <> struct KindTraits<AttributeKind::u64> : KindTraitsOf<AttributeKind::u64, std::uint64_t, &Attribute::Attribute_::u64, 8> { static constexpr char const* name = "u64"; };
+template <> struct KindTraits<AttributeKind::string> : KindTraitsOf<AttributeKind::string, std::string, &Attribute::Attribute_::string, 0> { static constexpr char const* name = "string"; };
+template <> struct KindTraits<AttributeKind::boolean> : KindTraitsOf<AttributeKind::boolean, bool, &Attribute::Attribute_::boolean, 1> { static constexpr char const* name = "boolean"; };
+template <> struct KindTraits<AttributeKind::float_> : KindTraitsOf<AttributeKind::float_, float, &Attribute::Attribute_::float_, 4> { static constexpr char const* name = "float"; };
+template <> struct KindTraits<AttributeKind::double_> : KindTraitsOf<AttributeKind::double_, double, &Attribute::Attribute_::double_, 8> { static constexpr char const* name = "double"; };
+// references are row ids stored as u32 on disk
+template <> struct KindTraits<AttributeKind::reference> : KindTraitsOf<AttributeKind::reference, std::uint64_t, &Attribute::Attribute_::reference, 4> { static constexpr char const* name = "ref"; };
+
+// calls f with the KindTraits of k, the one switch every kernel goes through so
+// branching on the kind happens once per operation instead of once per row
+template <typename F>
+decltype(auto) dispatch(AttributeKind k, F&& f) {
+    switch (k) {
+    case AttributeKind::i8: return f(KindTraits<AttributeKind::i8>{});
+    case AttributeKind::i16: return f(KindTraits<AttributeKind::i16>{});
+    case AttributeKind::i32: return f(KindTraits<AttributeKind::i32>{});
+    case AttributeKind::i64: return f(KindTraits<AttributeKind::i64>{});
+    case AttributeKind::u8: return f(KindTraits<AttributeKind::u8>{});
+    case AttributeKind::u16: return f(KindTraits<AttributeKind::u16>{});
+    case AttributeKind::u32: return f(KindTraits<AttributeKind::u32>{});
+    case AttributeKind::u64: return f(KindTraits<AttributeKind::u64>{});
+    case AttributeKind::string: return f(KindTraits<AttributeKind::string>{});
+    case AttributeKind::boolean: return f(KindTraits<AttributeKind::boolean>{});
+    case AttributeKind::float_: return f(KindTraits<AttributeKind::float_>{});
+    case AttributeKind::double_: return f(KindTraits<AttributeKind::double_>{});
+    case AttributeKind::reference: return f(KindTraits<AttributeKind::reference>{});
     }
-};
+    throw std::runtime_error("unhandled attr kind");
+}
+
+std::uint8_t attributeSize(AttributeKind k) {
+    return dispatch(k, [](auto t) -> std::uint8_t {
+        if constexpr (!decltype(t)::fixedWidth)
+            throw std::runtime_error("todo: variable width attribute");
+        return decltype(t)::size;
+    });
+}
+
+Attribute::Attribute(Attribute const& attr) : kind(attr.kind) {
+    dispatch(kind, [&](auto t) {
+        constexpr auto m = decltype(t)::member;
+        std::construct_at(&(data.*m), attr.data.*m);
+    });
+}
+
+Attribute& Attribute::operator=(Attribute const& attr) {
+    if (kind == AttributeKind::string && attr.kind != AttributeKind::string)
+        std::destroy_at(&data.string);
+    auto held = kind;
+    kind = attr.kind;
+    dispatch(kind, [&](auto t) {
+        constexpr auto m = decltype(t)::member;
+        if constexpr (decltype(t)::kind == AttributeKind::string)
+            if (held != AttributeKind::string)
+                return static_cast<void>(std::construct_at(&(data.*m), attr.data.*m));
+        data.*m = attr.data.*m;
+    });
+    return *this;
+}
 
 
 enum ControlMessage : byte {
@@ -206,6 +184,216 @@ void serialize(AttributeKind const& k, bytes& v) {
     serialize(static_cast<std::uint8_t>(k), v);
 }
 
+// how execute writes the payload: control byte framed (the default) or as the
+// columnar layout described in the readme where every buffer is 64 byte aligned
+enum class OutputFormat : byte {
+    frames,
+    columnar,
+};
+
+std::uint64_t const columnarAlignment = 64;
+char const columnarMagic[8] = { 'N', 'I', 'T', 'R', 'O', 'C', 'O', 'L' };
+std::uint32_t const columnarVersion = 1;
+
+// set on the type byte of a data frame whose column is nullable, the frame then
+// carries a validity bitmap of ceil(count / 64) u64 words before the values
+byte const nullableFlag = 0x80;
+
+enum class CompareOp : byte {
+    eq,
+    ne,
+    lt,
+    le,
+    gt,
+    ge,
+};
+
+// reads a numeric or boolean attribute as T, used to widen or narrow parsed
+// literals (which are always u64, double or bool) to a column's type
+template <typename T>
+T attrAs(Attribute const& a) {
+    return dispatch(a.kind, [&](auto t) -> T {
+        if constexpr (!decltype(t)::fixedWidth)
+            throw std::runtime_error("string attribute is not numeric");
+        else
+            return static_cast<T>(a.data.*decltype(t)::member);
+    });
+}
+
+std::string str(AttributeKind const& k);
+std::string str(Attribute const& attr);
+
+// whether the value of a numeric or boolean attribute is exactly representable
+// as T, integers must be in range and whole, floats only need to be in range
+template <typename T>
+bool fitsAs(Attribute const& a) {
+    return dispatch(a.kind, [&](auto t) -> bool {
+        using F = typename decltype(t)::type;
+        if constexpr (!decltype(t)::fixedWidth)
+            return false;
+        else {
+            auto x = a.data.*decltype(t)::member;
+            if constexpr (std::is_same_v<T, bool>)
+                return x == F(0) || x == F(1);
+            else if constexpr (std::is_same_v<F, bool>)
+                return true;
+            else if constexpr (std::is_floating_point_v<T>) {
+                if constexpr (std::is_floating_point_v<F>)
+                    return !std::isfinite(x) || std::fabs(x) <= std::numeric_limits<T>::max();
+                else
+                    return true;
+            }
+            else if constexpr (std::is_floating_point_v<F>) {
+                auto limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+                return x == std::trunc(x) && x < limit && x >= (std::is_signed_v<T> ? -limit : 0);
+            }
+            else
+                return std::in_range<T>(x);
+        }
+    });
+}
+
+std::string convertAttr(Attribute const& from, AttributeKind to, Attribute& out) {
+    if (from.kind == to) {
+        out = from;
+        return "";
+    }
+    if (from.kind == AttributeKind::string || to == AttributeKind::string)
+        return "Cannot convert between string and numeric values";
+    // references are u32 on disk
+    auto fits = to == AttributeKind::reference ? fitsAs<std::uint32_t>(from) : dispatch(to, [&](auto t) {
+        if constexpr (decltype(t)::fixedWidth)
+            return fitsAs<typename decltype(t)::type>(from);
+        else
+            return false;
+    });
+    if (!fits)
+        return "Value " + str(from) + " does not fit type " + str(to);
+    out.kind = to;
+    dispatch(to, [&](auto t) {
+        using T = typename decltype(t)::type;
+        if constexpr (decltype(t)::fixedWidth)
+            out.data.*decltype(t)::member = attrAs<T>(from);
+    });
+    return "";
+}
+
+// rounds a comparison literal to a value of kind to, the smallest value >= it
+// when up is set and the largest value <= it otherwise, false when the kind has
+// no such value; unlike convertAttr a literal the kind cannot hold is fine, a
+// predicate or range bound past a column's range still has a meaning
+bool roundAttr(Attribute const& from, AttributeKind to, bool up, Attribute& out) {
+    if (convertAttr(from, to, out).empty())
+        return true;
+    if (from.kind == AttributeKind::string || to == AttributeKind::string)
+        return false;
+    auto d = attrAs<double>(from);
+    return dispatch(to, [&](auto t) {
+        using T = typename decltype(t)::type;
+        if constexpr (!decltype(t)::fixedWidth)
+            return false;
+        else {
+            T x;
+            // only out of range values fail to convert to a floating kind
+            if constexpr (std::is_floating_point_v<T>) {
+                if (up == (d > 0))
+                    return false;
+                x = d > 0 ? std::numeric_limits<T>::max() : std::numeric_limits<T>::lowest();
+            }
+            else {
+                auto r = up ? std::ceil(d) : std::floor(d);
+                if (r < static_cast<double>(std::numeric_limits<T>::min())) {
+                    if (!up)
+                        return false;
+                    x = std::numeric_limits<T>::min();
+                }
+                else if (r >= std::ldexp(1.0, std::numeric_limits<T>::digits)) {
+                    if (up)
+                        return false;
+                    x = std::numeric_limits<T>::max();
+                }
+                else
+                    x = static_cast<T>(r);
+            }
+            out.kind = to;
+            out.data.*decltype(t)::member = x;
+            return true;
+        }
+    });
+}
+
+// calls f with the comparison functor of op
+template <typename F>
+decltype(auto) dispatch(CompareOp op, F&& f) {
+    switch (op) {
+    case CompareOp::eq: return f(std::equal_to<>{});
+    case CompareOp::ne: return f(std::not_equal_to<>{});
+    case CompareOp::lt: return f(std::less<>{});
+    case CompareOp::le: return f(std::less_equal<>{});
+    case CompareOp::gt: return f(std::greater<>{});
+    case CompareOp::ge: return f(std::greater_equal<>{});
+    }
+    throw std::runtime_error("unhandled compare op");
+}
+
+// maps a fixed width value to a u64 whose unsigned order matches the value's
+// order: signed values get their sign bit flipped, floating point values are
+// widened to double and have their bits flipped so negatives sort first
+template <typename T>
+std::uint64_t orderKeyOf(T x) {
+    if constexpr (std::is_floating_point_v<T>) {
+        auto b = std::bit_cast<std::uint64_t>(static_cast<double>(x));
+        return b >> 63 ? ~b : b | (std::uint64_t(1) << 63);
+    }
+    else if constexpr (std::is_signed_v<T>)
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(x)) ^ (std::uint64_t(1) << 63);
+    else
+        return static_cast<std::uint64_t>(x);
+}
+
+// inverse of orderKeyOf
+template <typename T>
+T fromOrderKeyOf(std::uint64_t k) {
+    if constexpr (std::is_floating_point_v<T>)
+        return static_cast<T>(std::bit_cast<double>(k >> 63 ? k & ~(std::uint64_t(1) << 63) : ~k));
+    else if constexpr (std::is_signed_v<T>)
+        return static_cast<T>(static_cast<std::int64_t>(k ^ (std::uint64_t(1) << 63)));
+    else
+        return static_cast<T>(k);
+}
+
+std::uint64_t orderKey(Attribute const& a) {
+    return dispatch(a.kind, [&](auto t) -> std::uint64_t {
+        if constexpr (!decltype(t)::fixedWidth)
+            throw std::runtime_error("string attribute has no order key");
+        else
+            return orderKeyOf(a.data.*decltype(t)::member);
+    });
+}
+
+void fromOrderKey(std::uint64_t k, Attribute& a) {
+    dispatch(a.kind, [&](auto t) {
+        using T = typename decltype(t)::type;
+        if constexpr (!decltype(t)::fixedWidth)
+            throw std::runtime_error("string attribute has no order key");
+        else
+            a.data.*decltype(t)::member = fromOrderKeyOf<T>(k);
+    });
+}
+
+enum class ImportFormat : byte {
+    csv,
+    binary,
+};
+
+enum class AggregateFn : byte {
+    count,
+    sum,
+    min,
+    max,
+    keys,
+};
+
 enum class InstructionKind {
     selectTable,
     createTable,
@@ -213,12 +401,26 @@ enum class InstructionKind {
     selectColumn,
     readColumn,
     appendColumn,
+    appendNull,
     end,
     send,
     open,
     close,
     sort,
     free,
+    deleteRow,
+    deleteWhere,
+    updateRow,
+    createIndex,
+    lookup,
+    importTable,
+    createSketch,
+    distinct,
+    quantile,
+    sample,
+    createAggregate,
+    aggregate,
+    sendSorted,
 };
 
 enum class PayloadKind : byte {
@@ -233,16 +435,30 @@ struct Instruction {
     union Instruction_ {
         struct { std::string name; } createTable;
         struct { std::string name; } selectTable;
-        struct { std::string name; AttributeKind type; } createColumn;
+        struct { std::string name; AttributeKind type; bool nullable; } createColumn;
         struct { std::string name; } selectColumn;
         struct {} readColumn;
         struct { Attribute attr;  } appendColumn;
+        struct {} appendNull;
         struct {} end;
         struct {} send;
         struct { PayloadKind kind; } open;
         struct { PayloadKind kind; } close;
         struct {  } sort;
         struct {  } free;
+        struct { std::uint64_t row; } deleteRow;
+        struct { CompareOp op; Attribute value; } deleteWhere;
+        struct { std::uint64_t row; Attribute value; } updateRow;
+        struct {} createIndex;
+        struct { Attribute low; Attribute high; } lookup;
+        struct { ImportFormat format; std::string file; } importTable;
+        struct {} createSketch;
+        struct {} distinct;
+        struct { std::vector<double> q; } quantile;
+        struct { std::uint64_t n; bool block; } sample;
+        struct { std::string key; } createAggregate;
+        struct { AggregateFn fn; std::string key; } aggregate;
+        struct {} sendSorted;
 
         Instruction_() {}
         ~Instruction_() {}
@@ -254,40 +470,82 @@ struct Instruction {
         switch (kind)
         {
         case InstructionKind::selectTable:
-            data.selectTable = i.data.selectTable;
+            std::construct_at(&data.selectTable, i.data.selectTable);
             break;
         case InstructionKind::createTable:
-            data.createTable = i.data.createTable;
+            std::construct_at(&data.createTable, i.data.createTable);
             break;
         case InstructionKind::createColumn:
-            data.createColumn = i.data.createColumn;
+            std::construct_at(&data.createColumn, i.data.createColumn);
             break;
         case InstructionKind::selectColumn:
-            data.selectColumn = i.data.selectColumn;
+            std::construct_at(&data.selectColumn, i.data.selectColumn);
             break;
         case InstructionKind::readColumn:
-            data.readColumn = i.data.readColumn;
+            std::construct_at(&data.readColumn, i.data.readColumn);
             break;
         case InstructionKind::appendColumn:
-            data.appendColumn = i.data.appendColumn;
+            std::construct_at(&data.appendColumn, i.data.appendColumn);
+            break;
+        case InstructionKind::appendNull:
+            std::construct_at(&data.appendNull, i.data.appendNull);
             break;
         case InstructionKind::end:
-            data.end = i.data.end;
+            std::construct_at(&data.end, i.data.end);
             break;
         case InstructionKind::send:
-            data.send = i.data.send;
+            std::construct_at(&data.send, i.data.send);
             break;
         case InstructionKind::open:
-            data.open = i.data.open;
+            std::construct_at(&data.open, i.data.open);
             break;
         case InstructionKind::close:
-            data.close = i.data.close;
+            std::construct_at(&data.close, i.data.close);
             break;
         case InstructionKind::sort:
-            data.sort = i.data.sort;
+            std::construct_at(&data.sort, i.data.sort);
             break;
         case InstructionKind::free:
-            data.free = i.data.free;
+            std::construct_at(&data.free, i.data.free);
+            break;
+        case InstructionKind::deleteRow:
+            std::construct_at(&data.deleteRow, i.data.deleteRow);
+            break;
+        case InstructionKind::deleteWhere:
+            std::construct_at(&data.deleteWhere, i.data.deleteWhere);
+            break;
+        case InstructionKind::updateRow:
+            std::construct_at(&data.updateRow, i.data.updateRow);
+            break;
+        case InstructionKind::createIndex:
+            std::construct_at(&data.createIndex, i.data.createIndex);
+            break;
+        case InstructionKind::lookup:
+            std::construct_at(&data.lookup, i.data.lookup);
+            break;
+        case InstructionKind::importTable:
+            std::construct_at(&data.importTable, i.data.importTable);
+            break;
+        case InstructionKind::createSketch:
+            std::construct_at(&data.createSketch, i.data.createSketch);
+            break;
+        case InstructionKind::distinct:
+            std::construct_at(&data.distinct, i.data.distinct);
+            break;
+        case InstructionKind::quantile:
+            std::construct_at(&data.quantile, i.data.quantile);
+            break;
+        case InstructionKind::sample:
+            std::construct_at(&data.sample, i.data.sample);
+            break;
+        case InstructionKind::createAggregate:
+            std::construct_at(&data.createAggregate, i.data.createAggregate);
+            break;
+        case InstructionKind::aggregate:
+            std::construct_at(&data.aggregate, i.data.aggregate);
+            break;
+        case InstructionKind::sendSorted:
+            std::construct_at(&data.sendSorted, i.data.sendSorted);
             break;
         }
     }
@@ -296,67 +554,21 @@ struct Instruction {
 #define abortIfFails(x) if (auto e = x; !e.empty()) return e
 
 std::string str(AttributeKind const& k) {
-    switch (k) {
-    case AttributeKind::i8:
-        return "i8";
-    case AttributeKind::i16:
-        return "i16";
-    case AttributeKind::i32:
-        return "i32";
-    case AttributeKind::i64:
-        return "i64";
-    case AttributeKind::u8:
-        return "u8";
-    case AttributeKind::u16:
-        return "u16";
-    case AttributeKind::u32:
-        return "u32";
-    case AttributeKind::u64:
-        return "u64";
-    case AttributeKind::string:
-        return "string";
-    case AttributeKind::boolean:
-        return "boolean";
-    case AttributeKind::float_:
-        return "float";
-    case AttributeKind::double_:
-        return "double";
-    case AttributeKind::reference:
-        return "ref";
-    }
-    throw std::system_error();
+    return dispatch(k, [](auto t) { return std::string(decltype(t)::name); });
 }
 
 std::string str(Attribute const& attr) {
-    switch (attr.kind) {
-    case AttributeKind::i8:
-        return std::to_string(attr.data.i8) + ": i8";
-    case AttributeKind::i16:
-        return std::to_string(attr.data.i16) + ": i16";
-    case AttributeKind::i32:
-        return std::to_string(attr.data.i32) + ": i32";
-    case AttributeKind::i64:
-        return std::to_string(attr.data.i64) + ": i64";
-    case AttributeKind::u8:
-        return std::to_string(attr.data.u8) + ": u8";
-    case AttributeKind::u16:
-        return std::to_string(attr.data.u16) + ": u16";
-    case AttributeKind::u32:
-        return std::to_string(attr.data.u32) + ": u32";
-    case AttributeKind::u64:
-        return std::to_string(attr.data.u64) + ": u64";
-    case AttributeKind::string:
-        return attr.data.string + ": string";
-    case AttributeKind::boolean:
-        return std::string(attr.data.boolean ? "true" : "false")  + ": bool";
-    case AttributeKind::float_:
-        return std::to_string(attr.data.float_) + ": float";
-    case AttributeKind::double_:
-        return std::to_string(attr.data.double_) + ": double";
-    case AttributeKind::reference:
-        return "ref";
-    }
-    throw std::system_error();
+    return dispatch(attr.kind, [&](auto t) {
+        auto const& x = attr.data.*decltype(t)::member;
+        if constexpr (decltype(t)::kind == AttributeKind::reference)
+            return std::string("ref");
+        else if constexpr (decltype(t)::kind == AttributeKind::string)
+            return x + ": string";
+        else if constexpr (decltype(t)::kind == AttributeKind::boolean)
+            return std::string(x ? "true" : "false") + ": bool";
+        else
+            return std::to_string(x) + ": " + decltype(t)::name;
+    });
 }
 
 std::string str(PayloadKind p) {
@@ -369,6 +581,29 @@ std::string str(PayloadKind p) {
     throw std::system_error();
 }
 
+std::string str(AggregateFn fn) {
+    switch (fn) {
+    case AggregateFn::count: return "count";
+    case AggregateFn::sum: return "sum";
+    case AggregateFn::min: return "min";
+    case AggregateFn::max: return "max";
+    case AggregateFn::keys: return "keys";
+    }
+    throw std::system_error();
+}
+
+std::string str(CompareOp op) {
+    switch (op) {
+    case CompareOp::eq: return "=";
+    case CompareOp::ne: return "!=";
+    case CompareOp::lt: return "<";
+    case CompareOp::le: return "<=";
+    case CompareOp::gt: return ">";
+    case CompareOp::ge: return ">=";
+    }
+    throw std::system_error();
+}
+
 void print(Instruction const& i) {
     switch (i.kind)
     {
@@ -377,13 +612,15 @@ void print(Instruction const& i) {
     case InstructionKind::createTable:
         return static_cast<void>(std::cout << "create table " << i.data.createTable.name << std::endl);
     case InstructionKind::createColumn:
-        return static_cast<void>(std::cout << "create column " << i.data.createColumn.name << ": " << str(i.data.createColumn.type) << std::endl);
+        return static_cast<void>(std::cout << "create column " << i.data.createColumn.name << ": " << str(i.data.createColumn.type) << (i.data.createColumn.nullable ? " nullable" : "") << std::endl);
     case InstructionKind::selectColumn:
         return static_cast<void>(std::cout << "select column " << i.data.selectColumn.name << std::endl);
     case InstructionKind::readColumn:
         return static_cast<void>(std::cout << "read" << std::endl);
     case InstructionKind::appendColumn:
         return static_cast<void>(std::cout << "append " << str(i.data.appendColumn.attr)  << std::endl);
+    case InstructionKind::appendNull:
+        return static_cast<void>(std::cout << "append null" << std::endl);
     case InstructionKind::end:
         return static_cast<void>(std::cout << "end" << std::endl);
     case InstructionKind::send:
@@ -396,231 +633,2918 @@ void print(Instruction const& i) {
         return static_cast<void>(std::cout << "sort" << std::endl);
     case InstructionKind::free:
         return static_cast<void>(std::cout << "free" << std::endl);
+    case InstructionKind::deleteRow:
+        return static_cast<void>(std::cout << "delete " << i.data.deleteRow.row << std::endl);
+    case InstructionKind::deleteWhere:
+        return static_cast<void>(std::cout << "delete where " << str(i.data.deleteWhere.op) << " " << str(i.data.deleteWhere.value) << std::endl);
+    case InstructionKind::updateRow:
+        return static_cast<void>(std::cout << "update " << i.data.updateRow.row << " " << str(i.data.updateRow.value) << std::endl);
+    case InstructionKind::createIndex:
+        return static_cast<void>(std::cout << "create index" << std::endl);
+    case InstructionKind::lookup:
+        return static_cast<void>(std::cout << "lookup " << str(i.data.lookup.low) << " " << str(i.data.lookup.high) << std::endl);
+    case InstructionKind::importTable:
+        return static_cast<void>(std::cout << "import " << (i.data.importTable.format == ImportFormat::csv ? "csv " : "binary ") << i.data.importTable.file << std::endl);
+    case InstructionKind::createSketch:
+        return static_cast<void>(std::cout << "create sketch" << std::endl);
+    case InstructionKind::distinct:
+        return static_cast<void>(std::cout << "distinct" << std::endl);
+    case InstructionKind::quantile:
+        std::cout << "quantile";
+        for (auto q : i.data.quantile.q)
+            std::cout << " " << q;
+        return static_cast<void>(std::cout << std::endl);
+    case InstructionKind::sample:
+        return static_cast<void>(std::cout << "sample " << (i.data.sample.block ? "block " : "") << i.data.sample.n << std::endl);
+    case InstructionKind::createAggregate:
+        return static_cast<void>(std::cout << "create aggregate" << (i.data.createAggregate.key.empty() ? "" : " by " + i.data.createAggregate.key) << std::endl);
+    case InstructionKind::aggregate:
+        return static_cast<void>(std::cout << "aggregate " << str(i.data.aggregate.fn) << (i.data.aggregate.key.empty() ? "" : " by " + i.data.aggregate.key) << std::endl);
+    case InstructionKind::sendSorted:
+        return static_cast<void>(std::cout << "send sorted" << std::endl);
     }
 }
 
-struct ColumnInfo {
-    AttributeKind type;
-    std::uint64_t count;
+// secondary index of a column as (order key, row) pairs sorted by key, a sparse
+// fence layer holds the first key of every block so a probe binary searches a
+// small cache resident array and then a single block, appended rows collect in
+// an unsorted tail that is folded in once it grows or before a probe
+class ColumnIndex {
+    static constexpr std::uint64_t blockEntries = 256;
+    static constexpr std::uint64_t tailLimit = 4096;
 
-    ColumnInfo() = default;
-    ColumnInfo(AttributeKind k, std::uint64_t c) : type(k), count(c) {}
+public:
+    struct Entry {
+        std::uint64_t key;
+        std::uint64_t row;
+
+        auto operator<=>(Entry const&) const = default;
+    };
+
+private:
+    std::vector<Entry> entries;
+    std::vector<Entry> tail;
+    std::vector<std::uint64_t> fences;
+
+    void rebuildFences() {
+        fences.clear();
+        for (std::uint64_t i = 0; i < entries.size(); i += blockEntries)
+            fences.push_back(entries[i].key);
+    }
+
+    void mergeTail() {
+        if (tail.empty())
+            return;
+        std::sort(tail.begin(), tail.end());
+        auto n = entries.size();
+        entries.insert(entries.end(), tail.begin(), tail.end());
+        std::inplace_merge(entries.begin(), entries.begin() + n, entries.end());
+        tail.clear();
+        rebuildFences();
+    }
+
+    // index of the first entry with key >= k
+    std::uint64_t lowerBound(std::uint64_t k) const {
+        auto f = std::lower_bound(fences.begin(), fences.end(), k);
+        // the first key >= k can sit in the block before the first fence >= k
+        auto block = f == fences.begin() ? 0 : (f - fences.begin()) - 1;
+        auto begin = entries.begin() + block * blockEntries;
+        auto end = entries.begin() + std::min<std::uint64_t>((block + 2) * blockEntries, entries.size());
+        return std::lower_bound(begin, end, Entry{ k, 0 }) - entries.begin();
+    }
+
+public:
+    bool dirty = false;
+
+    void build(std::vector<Entry> e) {
+        entries = std::move(e);
+        std::sort(entries.begin(), entries.end());
+        tail.clear();
+        rebuildFences();
+        dirty = true;
+    }
+
+    void insert(std::uint64_t key, std::uint64_t row) {
+        tail.push_back({ key, row });
+        if (tail.size() >= tailLimit)
+            mergeTail();
+        dirty = true;
+    }
+
+    // folds a whole batch of appended entries in with one sort and one merge
+    void insertBatch(std::vector<Entry> const& batch) {
+        if (batch.empty())
+            return;
+        tail.insert(tail.end(), batch.begin(), batch.end());
+        mergeTail();
+        dirty = true;
+    }
+
+    // drops the entries of every row at or past rows
+    void truncate(std::uint64_t rows) {
+        mergeTail();
+        std::erase_if(entries, [&](Entry const& e) { return e.row >= rows; });
+        rebuildFences();
+        dirty = true;
+    }
+
+    void erase(std::uint64_t key, std::uint64_t row) {
+        mergeTail();
+        auto it = std::lower_bound(entries.begin(), entries.end(), Entry{ key, row });
+        if (it != entries.end() && *it == Entry{ key, row }) {
+            entries.erase(it);
+            rebuildFences();
+            dirty = true;
+        }
+    }
+
+    // appends every entry with low <= key <= high to out, in key order
+    void range(std::uint64_t low, std::uint64_t high, std::vector<Entry>& out) {
+        mergeTail();
+        for (auto i = lowerBound(low); i < entries.size() && entries[i].key <= high; i++)
+            out.push_back(entries[i]);
+    }
+
+    void save(std::string const& filename) {
+        mergeTail();
+        std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(Entry));
+        dirty = false;
+    }
+
+    bool load(std::string const& filename) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(filename, ec);
+        if (ec)
+            return false;
+        entries.resize(size / sizeof(Entry));
+        std::ifstream f(filename, std::ios::binary);
+        f.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Entry));
+        tail.clear();
+        rebuildFences();
+        dirty = false;
+        return true;
+    }
 };
 
-struct TableInfo {
-    std::unordered_map<std::string, ColumnInfo> columns;
+// finalizer of splitmix64, spreads the bits of an order key over a whole word
+std::uint64_t mix64(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+// approximate distinct count in 2^14 one byte registers, each holding the
+// longest run of leading zeros seen among the hashes routed to it, the
+// standard error is about 0.8%
+class HyperLogLog {
+    static constexpr int precision = 14;
+    static constexpr std::uint64_t registerCount = std::uint64_t(1) << precision;
+
+public:
+    std::vector<std::uint8_t> registers = std::vector<std::uint8_t>(registerCount, 0);
+
+    void insert(std::uint64_t hash) {
+        auto& r = registers[hash >> (64 - precision)];
+        auto rank = static_cast<std::uint8_t>(std::countl_zero((hash << precision) | (std::uint64_t(1) << (precision - 1))) + 1);
+        r = std::max(r, rank);
+    }
+
+    void merge(HyperLogLog const& other) {
+        for (std::uint64_t i = 0; i < registerCount; i++)
+            registers[i] = std::max(registers[i], other.registers[i]);
+    }
+
+    std::uint64_t estimate() const {
+        double m = registerCount;
+        double sum = 0;
+        std::uint64_t zeros = 0;
+        for (auto r : registers) {
+            sum += std::ldexp(1.0, -r);
+            zeros += r == 0;
+        }
+        auto e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // linear counting is the better estimate while many registers are empty
+        if (e <= 2.5 * m && zeros != 0)
+            e = m * std::log(m / zeros);
+        return static_cast<std::uint64_t>(std::llround(e));
+    }
 };
 
-void loadAttrDataFromBytes(Attribute& d, char* b) {
-    switch (d.kind)
-    {
-    case AttributeKind::i8:
-        return static_cast<void>(std::copy(b, b + 1, reinterpret_cast<char*>(&d.data.i8)));
-    case AttributeKind::i16:
-        return static_cast<void>(std::copy(b, b + 2, reinterpret_cast<char*>(&d.data.i16)));
-    case AttributeKind::i32:
-        return static_cast<void>(std::copy(b, b + 4, reinterpret_cast<char*>(&d.data.i32)));
-    case AttributeKind::i64:
-        return static_cast<void>(std::copy(b, b + 8, reinterpret_cast<char*>(&d.data.i64)));
-    case AttributeKind::u8:
-        return static_cast<void>(std::copy(b, b + 1, reinterpret_cast<char*>(&d.data.u8)));
-    case AttributeKind::u16:
-        return static_cast<void>(std::copy(b, b + 2, reinterpret_cast<char*>(&d.data.u16)));
-    case AttributeKind::u32:
-        return static_cast<void>(std::copy(b, b + 4, reinterpret_cast<char*>(&d.data.u32)));
-    case AttributeKind::u64:
-        return static_cast<void>(std::copy(b, b + 8, reinterpret_cast<char*>(&d.data.u64)));
-    case AttributeKind::string:
-        throw "todo";
-    case AttributeKind::boolean:
-        return static_cast<void>(std::copy(b, b + 1, reinterpret_cast<char*>(&d.data.boolean)));
-    case AttributeKind::float_:
-        return static_cast<void>(std::copy(b, b + 4, reinterpret_cast<char*>(&d.data.float_)));
-    case AttributeKind::double_:
-        return static_cast<void>(std::copy(b, b + 8, reinterpret_cast<char*>(&d.data.double_)));
-    case AttributeKind::reference:
-        throw "todo";
+// KLL quantile sketch over order keys, level h holds items standing for 2^h
+// values each, a level that outgrows its capacity is sorted and every other
+// item (from a random start) is promoted to the level above, capacities shrink
+// geometrically towards the bottom so the sketch stays around 3k items
+class QuantileSketch {
+    static constexpr std::uint64_t k = 256;
+
+    std::vector<std::vector<std::uint64_t>> levels = std::vector<std::vector<std::uint64_t>>(1);
+    std::uint64_t coin = 0x9e3779b97f4a7c15;
+
+    std::uint64_t capacity(std::size_t h) const {
+        auto depth = levels.size() - 1 - h;
+        return std::max<std::uint64_t>(8, static_cast<std::uint64_t>(k * std::pow(2.0 / 3.0, depth)));
     }
-}
 
-struct DataBase {
-private:
-    // vm registers
-    std::string table;
-    std::string column;
-    std::vector<std::uint64_t> ordering;
-    std::vector<Attribute> data;
-    bytes payload;
+    void compress() {
+        for (std::size_t h = 0; h < levels.size(); h++) {
+            if (levels[h].size() < capacity(h))
+                continue;
+            if (h + 1 == levels.size())
+                levels.emplace_back();
+            auto& level = levels[h];
+            std::sort(level.begin(), level.end());
+            // an odd item out stays behind so the weights still add up
+            auto keep = level.size() % 2 ? level.back() : 0;
+            auto odd = level.size() % 2;
+            coin = mix64(coin);
+            for (std::size_t i = coin & 1; i + odd < level.size(); i += 2)
+                levels[h + 1].push_back(level[i]);
+            level.clear();
+            if (odd)
+                level.push_back(keep);
+        }
+    }
 
-    // vm state
-    std::unordered_map<std::string, TableInfo> tables;
-    std::string dumpFile;
+public:
+    std::uint64_t count = 0;
+    // kept exact, compaction may drop the extremes
+    std::uint64_t min = ~std::uint64_t(0);
+    std::uint64_t max = 0;
 
-    std::string columnFileName(std::string const& table, std::string const& column) {
-        return table + "/" + column;
+    void insert(std::uint64_t key) {
+        levels[0].push_back(key);
+        count++;
+        min = std::min(min, key);
+        max = std::max(max, key);
+        if (levels[0].size() >= capacity(0))
+            compress();
     }
-   
-    void createTableFile(std::string const& table) {
-        std::filesystem::create_directory(table);
+
+    void merge(QuantileSketch const& other) {
+        if (levels.size() < other.levels.size())
+            levels.resize(other.levels.size());
+        for (std::size_t h = 0; h < other.levels.size(); h++)
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        compress();
     }
 
-    void createColumnFile(std::string const& table, std::string const& column) {
-        std::ofstream f(columnFileName(table, column));
-        f.flush();
+    // order key of the value at rank q * count, q in [0, 1], the sketch must
+    // not be empty
+    std::uint64_t quantile(double q) const {
+        if (q <= 0)
+            return min;
+        if (q >= 1)
+            return max;
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> weighted;
+        std::uint64_t total = 0;
+        for (std::size_t h = 0; h < levels.size(); h++)
+            for (auto key : levels[h]) {
+                weighted.push_back({ key, std::uint64_t(1) << h });
+                total += std::uint64_t(1) << h;
+            }
+        std::sort(weighted.begin(), weighted.end());
+        auto target = static_cast<std::uint64_t>(q * total);
+        std::uint64_t seen = 0;
+        for (auto&& [key, weight] : weighted) {
+            seen += weight;
+            if (seen > target)
+                return key;
+        }
+        return weighted.back().first;
     }
 
-    std::fstream openColumnFile(std::string const& table, std::string const& column) {
-        return std::fstream(columnFileName(table, column), std::ios::binary);
+    void save(bytes& b) const {
+        serialize(count, b);
+        serialize(min, b);
+        serialize(max, b);
+        serialize(static_cast<std::uint64_t>(levels.size()), b);
+        for (auto&& level : levels) {
+            serialize(static_cast<std::uint64_t>(level.size()), b);
+            for (auto key : level)
+                serialize(key, b);
+        }
     }
 
-    std::fstream appendColumnFile(std::string const& table, std::string const& column) {
-        return std::fstream(columnFileName(table, column), std::ios::binary | std::ios::app);
+    void load(std::istream& f) {
+        auto get = [&](auto& x) { f.read(reinterpret_cast<char*>(&x), sizeof(x)); };
+        std::uint64_t depth = 0;
+        get(count);
+        get(min);
+        get(max);
+        get(depth);
+        levels.assign(std::max<std::uint64_t>(depth, 1), {});
+        for (std::uint64_t h = 0; h < depth && f; h++) {
+            std::uint64_t n = 0;
+            get(n);
+            levels[h].resize(n);
+            f.read(reinterpret_cast<char*>(levels[h].data()), n * sizeof(std::uint64_t));
+        }
     }
+};
 
-    std::uint64_t columnCount(std::string const& table, std::string const& column) {
-        return tables[table].columns[column].count;
+// approximate summary of every value appended to a column since the sketch was
+// created, deleted and overwritten values stay counted until it is created again
+struct ColumnSketch {
+    HyperLogLog distinct;
+    QuantileSketch quantiles;
+    bool dirty = false;
+
+    void insert(std::uint64_t key) {
+        distinct.insert(mix64(key));
+        quantiles.insert(key);
+        dirty = true;
     }
 
-    std::uint64_t addColumnCount(std::string const& table, std::string const& column, std::uint64_t amount) {
-        return tables[table].columns[column].count += amount;
+    void merge(ColumnSketch const& other) {
+        distinct.merge(other.distinct);
+        quantiles.merge(other.quantiles);
+        dirty = true;
     }
 
-    AttributeKind columnType(std::string const& table, std::string const& column) {
-        return tables[table].columns[column].type;
+    void save(std::string const& filename) {
+        bytes b(distinct.registers.begin(), distinct.registers.end());
+        quantiles.save(b);
+        std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<char const*>(b.data()), b.size());
+        dirty = false;
+    }
+
+    bool load(std::string const& filename) {
+        std::ifstream f(filename, std::ios::binary);
+        if (!f)
+            return false;
+        f.read(reinterpret_cast<char*>(distinct.registers.data()), distinct.registers.size());
+        quantiles.load(f);
+        dirty = false;
+        return true;
+    }
+};
+
+// kind a sum of values of kind k is kept in
+AttributeKind sumKindOf(AttributeKind k) {
+    return dispatch(k, [](auto t) {
+        using T = typename decltype(t)::type;
+        if constexpr (std::is_floating_point_v<T>)
+            return AttributeKind::double_;
+        else if constexpr (std::is_signed_v<T>)
+            return AttributeKind::i64;
+        else
+            return AttributeKind::u64;
+    });
+}
+
+// count, sum, min and max of the values of a column, per value of a key column
+// when grouped, folded in as rows are appended so reading one never scans;
+// deletes and updates leave it stale and the next read rebuilds it
+struct Aggregate {
+    struct Totals {
+        std::uint64_t count = 0;
+        Attribute sum;
+        // order keys of the smallest and largest value
+        std::uint64_t min = ~std::uint64_t(0);
+        std::uint64_t max = 0;
+    };
+
+    std::string value;
+    // key column, empty when not grouped
+    std::string key;
+    AttributeKind sumKind;
+    // by order key of the key column, a plain aggregate folds into group 0
+    std::map<std::uint64_t, Totals> groups;
+    bool stale = false;
+
+    // folds a value of a kind the caller dispatched on once for a whole run of
+    // rows, so the loop over them is typed
+    template <typename Traits>
+    void fold(Totals& g, typename Traits::type v) const {
+        using T = typename Traits::type;
+        if (g.count++ == 0) {
+            g.sum.kind = sumKind;
+            g.sum.data.u64 = 0;
+        }
+        if constexpr (std::is_floating_point_v<T>)
+            g.sum.data.double_ += v;
+        // two's complement, a signed sum wraps like the unsigned one
+        else if constexpr (std::is_signed_v<T>)
+            g.sum.data.u64 += static_cast<std::uint64_t>(static_cast<std::int64_t>(v));
+        else
+            g.sum.data.u64 += v;
+        g.min = std::min(g.min, orderKeyOf(v));
+        g.max = std::max(g.max, orderKeyOf(v));
+    }
+
+    template <typename Traits>
+    void fold(std::uint64_t group, typename Traits::type v) {
+        fold<Traits>(groups[group], v);
+    }
+
+    void fold(std::uint64_t group, Attribute const& x) {
+        dispatch(x.kind, [&](auto t) {
+            if constexpr (decltype(t)::fixedWidth)
+                fold<decltype(t)>(group, x.data.*decltype(t)::member);
+        });
+    }
+
+    // adds groups folded elsewhere, by order key like groups
+    template <typename Groups>
+    void merge(Groups const& other) {
+        for (auto&& [group, o] : other) {
+            if (o.count == 0)
+                continue;
+            auto& g = groups[group];
+            if (g.count == 0)
+                g.sum = o.sum;
+            else if (sumKind == AttributeKind::double_)
+                g.sum.data.double_ += o.sum.data.double_;
+            else
+                g.sum.data.u64 += o.sum.data.u64;
+            g.count += o.count;
+            g.min = std::min(g.min, o.min);
+            g.max = std::max(g.max, o.max);
+        }
+    }
+};
+
+// sets bits [from, to) of a packed bitmap, growing it as needed
+void setBits(std::vector<std::uint64_t>& words, std::uint64_t from, std::uint64_t to) {
+    if (words.size() < (to + 63) / 64)
+        words.resize((to + 63) / 64, 0);
+    for (auto i = from; i < to;) {
+        auto bit = i & 63;
+        auto n = std::min<std::uint64_t>(64 - bit, to - i);
+        words[i >> 6] |= (n == 64 ? ~std::uint64_t(0) : ((std::uint64_t(1) << n) - 1)) << bit;
+        i += n;
+    }
+}
+
+bool testBit(std::vector<std::uint64_t> const& words, std::uint64_t i) {
+    return (i >> 6) < words.size() && (words[i >> 6] >> (i & 63) & 1);
+}
+
+struct ColumnInfo {
+    AttributeKind type;
+    std::uint64_t count;
+    std::unique_ptr<ColumnIndex> index;
+    std::unique_ptr<ColumnSketch> sketch;
+    // nullable columns keep a bit per row, set when the row holds a value, null
+    // rows still take their fixed width slot in the column file
+    bool nullable = false;
+    std::vector<std::uint64_t> validity;
+    bool validityDirty = false;
+
+    ColumnInfo() = default;
+    ColumnInfo(AttributeKind k, std::uint64_t c, bool nullable = false) : type(k), count(c), nullable(nullable) {}
+};
+
+// set of row ids in the style of a roaring bitmap, rows are bucketed by their
+// high 48 bits into 2^16 row chunks, a chunk is a sorted array of the low 16 bits
+// while sparse and switches to a plain 1024 word bitmap once it is dense
+class RowBitmap {
+    static constexpr std::uint32_t arrayLimit = 4096;
+    static constexpr std::uint64_t chunkWords = 1024;
+
+    struct Chunk {
+        std::vector<std::uint16_t> array;
+        std::vector<std::uint64_t> bits;
+        std::uint32_t cardinality = 0;
+
+        bool contains(std::uint16_t low) const {
+            if (!bits.empty())
+                return bits[low >> 6] >> (low & 63) & 1;
+            return std::binary_search(array.begin(), array.end(), low);
+        }
+
+        bool add(std::uint16_t low) {
+            if (!bits.empty()) {
+                auto& w = bits[low >> 6];
+                auto m = std::uint64_t(1) << (low & 63);
+                if (w & m)
+                    return false;
+                w |= m;
+                cardinality++;
+                return true;
+            }
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it != array.end() && *it == low)
+                return false;
+            array.insert(it, low);
+            cardinality++;
+            if (cardinality > arrayLimit) {
+                bits.assign(chunkWords, 0);
+                for (auto x : array)
+                    bits[x >> 6] |= std::uint64_t(1) << (x & 63);
+                array.clear();
+                array.shrink_to_fit();
+            }
+            return true;
+        }
+
+        void fill(std::uint64_t* words) const {
+            if (!bits.empty())
+                return static_cast<void>(std::copy(bits.begin(), bits.end(), words));
+            std::fill(words, words + chunkWords, 0);
+            for (auto x : array)
+                words[x >> 6] |= std::uint64_t(1) << (x & 63);
+        }
+    };
+
+    std::map<std::uint64_t, Chunk> chunks;
+    std::uint64_t cardinality = 0;
+
+public:
+    static constexpr std::uint64_t chunkRows = 1 << 16;
+
+    bool empty() const {
+        return cardinality == 0;
+    }
+
+    std::uint64_t size() const {
+        return cardinality;
+    }
+
+    bool contains(std::uint64_t row) const {
+        auto it = chunks.find(row >> 16);
+        return it != chunks.end() && it->second.contains(row & 0xffff);
+    }
+
+    bool add(std::uint64_t row) {
+        auto added = chunks[row >> 16].add(row & 0xffff);
+        cardinality += added;
+        return added;
+    }
+
+    // writes the chunk holding row as a 1024 word bitmap (all zero if absent)
+    void fillChunk(std::uint64_t row, std::uint64_t* words) const {
+        auto it = chunks.find(row >> 16);
+        if (it == chunks.end())
+            return static_cast<void>(std::fill(words, words + chunkWords, 0));
+        it->second.fill(words);
+    }
+
+    // number of rows in [begin, end) that are in the set
+    std::uint64_t countRange(std::uint64_t begin, std::uint64_t end) const {
+        std::uint64_t n = 0;
+        std::vector<std::uint64_t> words(chunkWords);
+        for (auto it = chunks.lower_bound(begin >> 16); it != chunks.end() && (it->first << 16) < end; ++it) {
+            auto base = it->first << 16;
+            if (begin <= base && base + chunkRows <= end) {
+                n += it->second.cardinality;
+                continue;
+            }
+            it->second.fill(words.data());
+            for (auto r = std::max(begin, base); r < std::min(end, base + chunkRows); r++)
+                n += words[(r - base) >> 6] >> (r & 63) & 1;
+        }
+        return n;
+    }
+
+    void save(std::string const& filename) const {
+        bytes b;
+        serialize(static_cast<std::uint64_t>(chunks.size()), b);
+        for (auto&& [high, chunk] : chunks) {
+            serialize(high, b);
+            serialize(chunk.cardinality, b);
+            if (!chunk.bits.empty())
+                for (auto w : chunk.bits) serialize(w, b);
+            else
+                for (auto x : chunk.array) serialize(x, b);
+        }
+        std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<char const*>(b.data()), b.size());
+    }
+
+    void load(std::string const& filename) {
+        chunks.clear();
+        cardinality = 0;
+        std::ifstream f(filename, std::ios::binary);
+        if (!f)
+            return;
+        auto get = [&](auto& x) { f.read(reinterpret_cast<char*>(&x), sizeof(x)); };
+        std::uint64_t n = 0;
+        get(n);
+        for (std::uint64_t i = 0; i < n && f; i++) {
+            std::uint64_t high;
+            Chunk chunk;
+            get(high);
+            get(chunk.cardinality);
+            if (chunk.cardinality > arrayLimit) {
+                chunk.bits.resize(chunkWords);
+                f.read(reinterpret_cast<char*>(chunk.bits.data()), chunkWords * sizeof(std::uint64_t));
+            }
+            else {
+                chunk.array.resize(chunk.cardinality);
+                f.read(reinterpret_cast<char*>(chunk.array.data()), chunk.cardinality * sizeof(std::uint16_t));
+            }
+            cardinality += chunk.cardinality;
+            chunks[high] = std::move(chunk);
+        }
+    }
+};
+
+struct TableInfo {
+    std::unordered_map<std::string, ColumnInfo> columns;
+    // column names in creation order
+    std::vector<std::string> order;
+    RowBitmap deleted;
+    bool deletedDirty = false;
+    std::vector<Aggregate> aggregates;
+    bool aggregatesDirty = false;
+};
+
+// copies a value of the kind's on disk width out of b
+template <typename Traits>
+typename Traits::type loadFromBytes(char const* b) {
+    typename Traits::type x{};
+    memcpy(&x, b, Traits::size);
+    return x;
+}
+
+void loadAttrDataFromBytes(Attribute& d, char const* b) {
+    dispatch(d.kind, [&](auto t) {
+        if constexpr (!decltype(t)::fixedWidth)
+            throw std::runtime_error("todo: load variable width attribute");
+        else
+            d.data.*decltype(t)::member = loadFromBytes<decltype(t)>(b);
+    });
+}
+
+// parses one text field into the kind's on disk representation at out
+template <typename Traits>
+bool parseField(std::string_view field, char* out) {
+    typename Traits::type x{};
+    if constexpr (Traits::kind == AttributeKind::boolean) {
+        if (field == "true" || field == "1") x = true;
+        else if (field == "false" || field == "0") x = false;
+        else return false;
+    }
+    else if constexpr (Traits::fixedWidth) {
+        auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), x);
+        if (ec != std::errc() || end != field.data() + field.size())
+            return false;
+    }
+    else
+        return false;
+    memcpy(out, &x, Traits::size);
+    return true;
+}
+
+std::vector<std::string> split(std::string const& s, char c) {
+    std::vector<std::string> words;
+    std::string buff;
+    for (auto&& x : s)
+        if (x == c && buff != "") {
+            words.push_back(buff);
+            buff.clear();
+        }
+        else {
+            buff += x;
+        }
+    if (!buff.empty())
+        words.push_back(buff);
+    return words;
+}
+
+// rows per unit of parallel work, small enough to balance across cores and
+// large enough that claiming a morsel is noise compared to processing it
+std::uint64_t const morselRows = 1 << 16;
+
+// morsel driven worker pool, a job over [0, count) is cut into fixed size
+// morsels which are dealt round robin into per worker queues, a worker drains
+// its own queue from the front and steals from the back of the others once
+// it runs dry, the calling thread works alongside the pool
+class MorselPool {
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::pair<std::uint64_t, std::uint64_t>> morsels;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::function<void(std::uint64_t, std::uint64_t)> const* job = nullptr;
+    std::exception_ptr failure;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation = 0;
+    std::size_t active = 0;
+    bool stopping = false;
+
+    bool claim(std::size_t self, std::pair<std::uint64_t, std::uint64_t>& range) {
+        {
+            auto& q = *queues[self];
+            std::lock_guard g(q.lock);
+            if (!q.morsels.empty()) {
+                range = q.morsels.front();
+                q.morsels.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            auto& q = *queues[(self + i) % queues.size()];
+            std::lock_guard g(q.lock);
+            if (!q.morsels.empty()) {
+                range = q.morsels.back();
+                q.morsels.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void drain(std::size_t self) {
+        std::pair<std::uint64_t, std::uint64_t> range;
+        while (claim(self, range)) {
+            try {
+                (*job)(range.first, range.second);
+            }
+            catch (...) {
+                std::lock_guard g(lock);
+                if (!failure)
+                    failure = std::current_exception();
+            }
+        }
+    }
+
+    void work(std::size_t self) {
+        std::uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock g(lock);
+                wake.wait(g, [&]{ return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            drain(self);
+            {
+                std::lock_guard g(lock);
+                if (--active == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+public:
+    MorselPool(std::size_t n = std::thread::hardware_concurrency()) {
+        n = std::max<std::size_t>(n, 1);
+        // queue 0 belongs to the calling thread
+        for (std::size_t i = 0; i < n; i++)
+            queues.push_back(std::make_unique<Queue>());
+        for (std::size_t i = 1; i < n; i++)
+            threads.emplace_back([this, i]{ work(i); });
+    }
+
+    ~MorselPool() {
+        {
+            std::lock_guard g(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto&& t : threads)
+            t.join();
+    }
+
+    std::size_t size() const {
+        return queues.size();
+    }
+
+    // runs fn over [0, count) in chunks of grain, blocks until every chunk is done
+    // and rethrows the first exception raised by any chunk
+    void parallelFor(std::uint64_t count, std::function<void(std::uint64_t, std::uint64_t)> const& fn, std::uint64_t grain = morselRows) {
+        if (count == 0)
+            return;
+        if (threads.empty() || count <= grain)
+            return fn(0, count);
+
+        std::uint64_t m = 0;
+        for (std::uint64_t b = 0; b < count; b += grain, m++) {
+            auto& q = *queues[m % queues.size()];
+            q.morsels.emplace_back(b, std::min(b + grain, count));
+        }
+
+        {
+            std::lock_guard g(lock);
+            job = &fn;
+            failure = nullptr;
+            active = threads.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        drain(0);
+
+        std::unique_lock g(lock);
+        done.wait(g, [&]{ return active == 0; });
+        job = nullptr;
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+};
+
+// rows [index * blockRows, (index + 1) * blockRows) of a column as they are on
+// disk, so a cached row costs its kind's width and not a whole Attribute, the
+// values are decoded with the kind's traits as they are read out
+struct ColumnBlock {
+    static constexpr std::uint64_t blockRows = morselRows;
+
+    AttributeKind type;
+    std::vector<char> raw;
+
+    template <typename Traits>
+    typename Traits::type at(std::uint64_t i) const {
+        return loadFromBytes<Traits>(raw.data() + i * Traits::size);
+    }
+
+    void load(std::uint64_t i, Attribute& x) const {
+        x.kind = type;
+        loadAttrDataFromBytes(x, raw.data() + i * attributeSize(type));
+    }
+};
+
+// memory bounded cache of column blocks shared by every program a
+// DataBase executes, keyed by table/column/block and evicted least recently used
+// first, a block is pinned for as long as someone holds the pointer pin handed
+// out so blocks in use are never evicted, only dropped from the cache
+class BlockCache {
+    struct Slot {
+        std::shared_ptr<ColumnBlock const> block;
+        std::uint64_t bytes;
+        std::list<std::string>::iterator recent;
+    };
+
+    std::unordered_map<std::string, Slot> slots;
+    std::list<std::string> recent;
+    std::uint64_t budget;
+    std::uint64_t used = 0;
+    std::mutex lock;
+
+    void evict() {
+        for (auto it = recent.end(); used > budget && it != recent.begin();) {
+            --it;
+            auto slot = slots.find(*it);
+            if (slot->second.block.use_count() > 1)
+                continue;
+            used -= slot->second.bytes;
+            evictions++;
+            slots.erase(slot);
+            it = recent.erase(it);
+        }
+    }
+
+    void drop(std::unordered_map<std::string, Slot>::iterator slot) {
+        used -= slot->second.bytes;
+        recent.erase(slot->second.recent);
+        slots.erase(slot);
+    }
+
+public:
+    std::atomic<std::uint64_t> hits = 0;
+    std::atomic<std::uint64_t> misses = 0;
+    std::atomic<std::uint64_t> evictions = 0;
+
+    BlockCache(std::uint64_t budget) : budget(budget) {}
+
+    static std::string key(std::string const& table, std::string const& column, std::uint64_t block) {
+        return table + "/" + column + "#" + std::to_string(block);
+    }
+
+    // the block pinned for as long as the returned pointer lives, null on a miss
+    std::shared_ptr<ColumnBlock const> pin(std::string const& key) {
+        std::lock_guard g(lock);
+        auto slot = slots.find(key);
+        if (slot == slots.end()) {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        recent.splice(recent.begin(), recent, slot->second.recent);
+        return slot->second.block;
+    }
+
+    // caches a freshly read block and returns it pinned, if another reader
+    // raced us to it the cached copy wins
+    std::shared_ptr<ColumnBlock const> insert(std::string const& key, std::shared_ptr<ColumnBlock const> block) {
+        std::lock_guard g(lock);
+        if (auto slot = slots.find(key); slot != slots.end())
+            return slot->second.block;
+        recent.push_front(key);
+        auto bytes = block->raw.capacity();
+        slots[key] = Slot{ block, bytes, recent.begin() };
+        used += bytes;
+        evict();
+        return block;
+    }
+
+    // the block pinned if it is cached, without touching recency or the counters
+    std::shared_ptr<ColumnBlock const> peek(std::string const& key) {
+        std::lock_guard g(lock);
+        auto slot = slots.find(key);
+        return slot == slots.end() ? nullptr : slot->second.block;
+    }
+
+    void invalidate(std::string const& key) {
+        std::lock_guard g(lock);
+        if (auto slot = slots.find(key); slot != slots.end())
+            drop(slot);
+    }
+
+    void invalidateColumn(std::string const& table, std::string const& column) {
+        std::lock_guard g(lock);
+        auto prefix = table + "/" + column + "#";
+        for (auto slot = slots.begin(); slot != slots.end();)
+            if (slot->first.starts_with(prefix))
+                drop(slot++);
+            else
+                ++slot;
+    }
+
+    std::uint64_t bytesUsed() {
+        std::lock_guard g(lock);
+        return used;
+    }
+
+    std::uint64_t capacity() const {
+        return budget;
+    }
+};
+
+// single background thread running queued jobs in order, used to load columns
+// into the block cache ahead of the instructions that read them
+class Prefetcher {
+    std::deque<std::function<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool busy = false;
+    bool stopping = false;
+    // last so it starts once everything it touches is constructed
+    std::thread thread;
+
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock g(lock);
+                wake.wait(g, [&]{ return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                busy = true;
+            }
+            // a failed prefetch only means the read will load the column itself
+            try { job(); } catch (...) {}
+            {
+                std::lock_guard g(lock);
+                busy = false;
+                if (jobs.empty())
+                    idle.notify_all();
+            }
+        }
+    }
+
+public:
+    Prefetcher() : thread([this]{ work(); }) {}
+
+    ~Prefetcher() {
+        {
+            std::lock_guard g(lock);
+            stopping = true;
+            jobs.clear();
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void push(std::function<void()> job) {
+        {
+            std::lock_guard g(lock);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // blocks until every queued job has finished
+    void wait() {
+        std::unique_lock g(lock);
+        idle.wait(g, [&]{ return jobs.empty() && !busy; });
+    }
+};
+
+struct DataBase {
+private:
+    // vm registers
+    std::string table;
+    std::string column;
+    std::vector<std::uint64_t> ordering;
+    std::vector<Attribute> data;
+    // one bit per row of data, empty while every loaded row holds a value
+    std::vector<std::uint64_t> validity;
+    bytes payload;
+    // the output file once part of the payload has been flushed to it
+    FILE* dump = nullptr;
+    // bytes of the output already in dump, payload holds what follows them
+    std::uint64_t flushed = 0;
+
+    // vm state
+    std::unordered_map<std::string, TableInfo> tables;
+    std::string dumpFile;
+    MorselPool workers;
+    BlockCache cache;
+    OutputFormat format;
+    std::uint64_t columnsSent = 0;
+    Prefetcher prefetcher;
+    std::atomic<std::uint64_t> prefetched = 0;
+    // table/column of every column queued for prefetch since the last write
+    std::unordered_set<std::string> queued;
+    // blocks prefetched for each column whose read has not happened yet, held
+    // so they stay pinned, a read that just ran is more recent than them and
+    // would otherwise be evicted last
+    std::unordered_map<std::string, std::vector<std::shared_ptr<ColumnBlock const>>> ahead;
+    std::mutex aheadLock;
+    std::mt19937_64 random{ std::random_device{}() };
+    // bytes of values send sorted holds in memory before spilling runs
+    std::uint64_t sortBytes;
+
+    std::string columnFileName(std::string const& table, std::string const& column) {
+        return table + "/" + column;
+    }
+
+    // one "<column> <type byte>" line per column in creation order, counts are
+    // recovered from the column file sizes when a table is loaded
+    std::string catalogFileName(std::string const& table) {
+        return table + "/.catalog";
+    }
+
+    std::string deletedFileName(std::string const& table) {
+        return table + "/.deleted";
+    }
+
+    std::string indexFileName(std::string const& table, std::string const& column) {
+        return table + "/." + column + ".idx";
+    }
+
+    std::string validityFileName(std::string const& table, std::string const& column) {
+        return table + "/." + column + ".valid";
+    }
+
+    std::string sketchFileName(std::string const& table, std::string const& column) {
+        return table + "/." + column + ".sketch";
+    }
+
+    // run of an external sort, removed once the sort is done
+    std::string sortRunFileName(std::string const& table, std::string const& column, std::uint64_t run) {
+        return table + "/.sort." + column + "." + std::to_string(run);
+    }
+
+    // per aggregate a "<value> <key or -> <sum type> <stale> <groups>" line followed
+    // by a "<key> <count> <sum bits> <min> <max>" line per group
+    std::string aggregatesFileName(std::string const& table) {
+        return table + "/.aggregates";
+    }
+
+    bool loadTable(std::string const& name) {
+        std::ifstream f(catalogFileName(name));
+        if (!f)
+            return false;
+        TableInfo info;
+        std::string line;
+        while (std::getline(f, line)) {
+            std::istringstream words(line);
+            std::string col, flag;
+            int type;
+            if (!(words >> col >> type))
+                continue;
+            words >> flag;
+            auto k = static_cast<AttributeKind>(type);
+            std::error_code ec;
+            auto size = std::filesystem::file_size(columnFileName(name, col), ec);
+            // nothing is ever appended to a string column yet
+            auto count = ec || k == AttributeKind::string ? 0 : size / attributeSize(k);
+            auto& c = info.columns[col] = ColumnInfo(k, count, flag == "nullable");
+            info.order.push_back(col);
+            if (auto index = std::make_unique<ColumnIndex>(); index->load(indexFileName(name, col)))
+                c.index = std::move(index);
+            if (auto sketch = std::make_unique<ColumnSketch>(); sketch->load(sketchFileName(name, col)))
+                c.sketch = std::move(sketch);
+            if (c.nullable) {
+                c.validity.resize((c.count + 63) / 64, 0);
+                std::ifstream v(validityFileName(name, col), std::ios::binary);
+                v.read(reinterpret_cast<char*>(c.validity.data()), c.validity.size() * sizeof(std::uint64_t));
+            }
+        }
+        info.deleted.load(deletedFileName(name));
+        std::ifstream a(aggregatesFileName(name));
+        Aggregate agg;
+        int sumKind;
+        std::uint64_t groups;
+        while (a >> agg.value >> agg.key >> sumKind >> agg.stale >> groups) {
+            if (agg.key == "-")
+                agg.key.clear();
+            agg.sumKind = static_cast<AttributeKind>(sumKind);
+            agg.groups.clear();
+            for (std::uint64_t i = 0; i < groups; i++) {
+                std::uint64_t group;
+                Aggregate::Totals t;
+                t.sum.kind = agg.sumKind;
+                a >> group >> t.count >> t.sum.data.u64 >> t.min >> t.max;
+                agg.groups[group] = t;
+            }
+            info.aggregates.push_back(agg);
+        }
+        tables[name] = std::move(info);
+        return true;
+    }
+
+    void saveTables() {
+        for (auto&& [name, info] : tables) {
+            if (info.deletedDirty) {
+                info.deleted.save(deletedFileName(name));
+                info.deletedDirty = false;
+            }
+            if (info.aggregatesDirty) {
+                std::ofstream a(aggregatesFileName(name), std::ios::trunc);
+                for (auto&& agg : info.aggregates) {
+                    a << agg.value << " " << (agg.key.empty() ? "-" : agg.key) << " " << static_cast<int>(agg.sumKind) << " " << agg.stale << " " << agg.groups.size() << "\n";
+                    for (auto&& [group, t] : agg.groups)
+                        a << group << " " << t.count << " " << t.sum.data.u64 << " " << t.min << " " << t.max << "\n";
+                }
+                info.aggregatesDirty = false;
+            }
+            for (auto&& [col, c] : info.columns) {
+                if (c.index && c.index->dirty)
+                    c.index->save(indexFileName(name, col));
+                if (c.sketch && c.sketch->dirty)
+                    c.sketch->save(sketchFileName(name, col));
+                if (c.validityDirty) {
+                    c.validity.resize((c.count + 63) / 64, 0);
+                    std::ofstream v(validityFileName(name, col), std::ios::binary | std::ios::trunc);
+                    v.write(reinterpret_cast<char const*>(c.validity.data()), c.validity.size() * sizeof(std::uint64_t));
+                    c.validityDirty = false;
+                }
+            }
+        }
+    }
+   
+    // the catalog is created empty so a table with no columns yet still loads
+    void createTableFile(std::string const& table) {
+        std::filesystem::create_directory(table);
+        std::ofstream catalog(catalogFileName(table), std::ios::app);
+    }
+
+    void createColumnFile(std::string const& table, std::string const& column) {
+        std::ofstream f(columnFileName(table, column));
+        f.flush();
+        std::ofstream catalog(catalogFileName(table), std::ios::app);
+        catalog << column << " " << static_cast<int>(columnType(table, column)) << (tables[table].columns[column].nullable ? " nullable" : "") << "\n";
+    }
+
+    std::fstream openColumnFile(std::string const& table, std::string const& column) {
+        return std::fstream(columnFileName(table, column), std::ios::binary);
+    }
+
+    std::fstream appendColumnFile(std::string const& table, std::string const& column) {
+        return std::fstream(columnFileName(table, column), std::ios::binary | std::ios::app);
+    }
+
+    std::fstream updateColumnFile(std::string const& table, std::string const& column) {
+        return std::fstream(columnFileName(table, column), std::ios::binary | std::ios::in | std::ios::out);
+    }
+
+    std::uint64_t tableRowCount(std::string const& table) {
+        std::uint64_t n = 0;
+        for (auto&& [_, c] : tables[table].columns)
+            n = std::max(n, c.count);
+        return n;
+    }
+
+    void writeAttr(std::fstream& f, Attribute const& attr) {
+        dispatch(attr.kind, [&](auto t) {
+            if constexpr (decltype(t)::fixedWidth)
+                f.write(reinterpret_cast<char const*>(&(attr.data.*decltype(t)::member)), decltype(t)::size);
+        });
+    }
+
+    std::uint64_t columnCount(std::string const& table, std::string const& column) {
+        return tables[table].columns[column].count;
+    }
+
+    std::uint64_t addColumnCount(std::string const& table, std::string const& column, std::uint64_t amount) {
+        return tables[table].columns[column].count += amount;
+    }
+
+    AttributeKind columnType(std::string const& table, std::string const& column) {
+        return tables[table].columns[column].type;
+    }
+
+    ColumnIndex* columnIndex(std::string const& table, std::string const& column) {
+        return tables[table].columns[column].index.get();
+    }
+
+    // block b of a column holding count rows, pinned out of the cache or read from
+    // the column file (opened into f on first use, the caller closes it) and
+    // cached, null when the file cannot be read; every write to a column file
+    // waits for the prefetcher and invalidates the blocks it touches so a cached
+    // block always matches the file. safe to call off the main thread
+    std::shared_ptr<ColumnBlock const> loadBlock(std::string const& table, std::string const& column, std::uint64_t b, std::uint64_t count, AttributeKind type, FILE*& f) {
+        auto key = BlockCache::key(table, column, b);
+        if (auto block = cache.pin(key))
+            return block;
+        auto filename = columnFileName(table, column);
+        if (f == nullptr && (f = fopen(filename.c_str(), "rb")) == nullptr)
+            return nullptr;
+        auto first = b * ColumnBlock::blockRows;
+        auto s = attributeSize(type);
+        auto block = std::make_shared<ColumnBlock>();
+        block->type = type;
+        block->raw.resize(std::min(ColumnBlock::blockRows, count - first) * s);
+        fseek(f, first * s, SEEK_SET);
+        if (fread(block->raw.data(), 1, block->raw.size(), f) != block->raw.size())
+            return nullptr;
+        return cache.insert(key, std::move(block));
+    }
+
+    // the value at row of a column, out of its block when that is cached and read
+    // on its own from the column file (opened into f on first use, the caller
+    // closes it) otherwise, so a single value never costs a whole block
+    bool readValue(std::string const& table, std::string const& column, FILE*& f, std::uint64_t row, Attribute& out) {
+        auto const& info = tables[table].columns[column];
+        auto b = row / ColumnBlock::blockRows;
+        if (auto block = cache.pin(BlockCache::key(table, column, b))) {
+            block->load(row - b * ColumnBlock::blockRows, out);
+            return true;
+        }
+        auto filename = columnFileName(table, column);
+        if (f == nullptr && (f = fopen(filename.c_str(), "rb")) == nullptr)
+            return false;
+        auto s = attributeSize(info.type);
+        char bytes[sizeof(std::uint64_t)];
+        fseek(f, row * s, SEEK_SET);
+        if (fread(bytes, 1, s, f) != s)
+            return false;
+        out.kind = info.type;
+        loadAttrDataFromBytes(out, bytes);
+        return true;
+    }
+
+    // appends the rows of a column to d leaving out the rows in skip, one block per
+    // task: the block is taken from the cache or read on a miss and decoded into
+    // d, the live rows of every block are counted up front so each block knows
+    // where its rows land in d
+    std::string loadColumn(std::string const& table, std::string const& column, std::vector<Attribute>& d, RowBitmap const* skip = nullptr) {
+        auto count = columnCount(table, column);
+        auto type = columnType(table, column);
+        auto blocks = (count + ColumnBlock::blockRows - 1) / ColumnBlock::blockRows;
+        auto n = d.size();
+
+        std::vector<std::uint64_t> offsets(blocks + 1, 0);
+        for (std::uint64_t b = 0; b < blocks; b++) {
+            auto begin = b * ColumnBlock::blockRows;
+            auto end = std::min(begin + ColumnBlock::blockRows, count);
+            offsets[b + 1] = offsets[b] + (end - begin) - (skip ? skip->countRange(begin, end) : 0);
+        }
+        d.resize(n + offsets[blocks]);
+
+        auto filename = columnFileName(table, column);
+        std::atomic<bool> unreadable = false;
+        workers.parallelFor(blocks, [&](std::uint64_t begin, std::uint64_t end) {
+            FILE* f = nullptr;
+            std::vector<std::uint64_t> words(RowBitmap::chunkRows / 64);
+            for (auto b = begin; b < end; b++) {
+                auto first = b * ColumnBlock::blockRows;
+                auto rows = std::min(ColumnBlock::blockRows, count - first);
+                auto block = loadBlock(table, column, b, count, type, f);
+                if (!block) {
+                    unreadable = true;
+                    break;
+                }
+
+                // the kind is the same for the whole block so it is picked once
+                // and every row is a plain typed load
+                auto o = d.data() + n + offsets[b];
+                auto whole = skip == nullptr || offsets[b + 1] - offsets[b] == rows;
+                if (!whole)
+                    skip->fillChunk(first, words.data());
+                dispatch(type, [&](auto t) {
+                    using Traits = decltype(t);
+                    if constexpr (Traits::fixedWidth) {
+                        for (std::uint64_t i = 0; i < rows; i++) {
+                            if (!whole && words[i >> 6] >> (i & 63) & 1)
+                                continue;
+                            o->kind = Traits::kind;
+                            o->data.*Traits::member = block->at<Traits>(i);
+                            o++;
+                        }
+                    }
+                });
+            }
+            if (f != nullptr)
+                fclose(f);
+        }, 1);
+
+        if (unreadable) {
+            d.resize(n);
+            return "Cannot read column file " + filename;
+        }
+        return "";
+    }
+
+    // the value at row of a column, false when the row is past the end of the
+    // column or null
+    bool valueAt(std::string const& table, std::string const& column, std::uint64_t row, Attribute& out) {
+        auto& info = tables[table].columns[column];
+        if (row >= info.count || (info.nullable && !testBit(info.validity, row)))
+            return false;
+        FILE* f = nullptr;
+        auto found = readValue(table, column, f, row, out);
+        if (f != nullptr)
+            fclose(f);
+        return found;
+    }
+
+    // keeps what is derived from a column in step with a value appended at row, a
+    // grouped aggregate takes the row once both its key and value are in
+    void maintainAppend(std::string const& table, std::string const& column, std::uint64_t row, Attribute const& value) {
+        auto& info = tables[table].columns[column];
+        if (info.index)
+            info.index->insert(orderKey(value), row);
+        if (info.sketch)
+            info.sketch->insert(orderKey(value));
+        // a row deleted before this column reached it stays out of aggregates
+        if (tables[table].deleted.contains(row))
+            return;
+        for (auto&& agg : tables[table].aggregates) {
+            if (agg.stale)
+                continue;
+            Attribute other;
+            if (agg.value == column && agg.key.empty())
+                agg.fold(0, value);
+            else if (agg.value == column && agg.key == column)
+                agg.fold(orderKey(value), value);
+            else if (agg.value == column && valueAt(table, agg.key, row, other))
+                agg.fold(orderKey(other), value);
+            else if (agg.key == column && valueAt(table, agg.value, row, other))
+                agg.fold(orderKey(value), other);
+            else
+                continue;
+            tables[table].aggregatesDirty = true;
+        }
+    }
+
+    // recomputes an aggregate from the live rows of its columns, each morsel into
+    // groups of its own that are merged once the morsel is done
+    std::string rebuildAggregate(Aggregate& agg) {
+        auto& info = tables[table];
+        auto const& valueInfo = info.columns[agg.value];
+        std::vector<Attribute> values, keys;
+        abortIfFails(loadColumn(table, agg.value, values));
+        if (!agg.key.empty() && agg.key != agg.value)
+            abortIfFails(loadColumn(table, agg.key, keys));
+        auto const& keyInfo = info.columns[agg.key.empty() ? agg.value : agg.key];
+        auto rows = agg.key.empty() || agg.key == agg.value ? values.size() : std::min(values.size(), keys.size());
+
+        agg.groups.clear();
+        std::mutex lock;
+        auto const& keyValues = agg.key == agg.value ? values : keys;
+        auto nullKeys = !agg.key.empty() && agg.key != agg.value && keyInfo.nullable;
+        workers.parallelFor(rows, [&](std::uint64_t begin, std::uint64_t end) {
+            // hashed while folding, the ordered groups only take the merge
+            std::unordered_map<std::uint64_t, Aggregate::Totals> local;
+            auto only = agg.key.empty() ? &local[0] : nullptr;
+            // the group of every row of the morsel first, then the values, each
+            // loop typed by a single dispatch
+            std::vector<std::uint64_t> group(only ? 0 : end - begin);
+            if (!only)
+                dispatch(keyInfo.type, [&](auto t) {
+                    using Traits = decltype(t);
+                    if constexpr (Traits::fixedWidth)
+                        for (auto i = begin; i < end; i++)
+                            group[i - begin] = orderKeyOf(keyValues[i].data.*Traits::member);
+                });
+            dispatch(valueInfo.type, [&](auto t) {
+                using Traits = decltype(t);
+                if constexpr (Traits::fixedWidth)
+                    forEachLive(valueInfo, info.deleted, true, begin, end, [&](std::uint64_t i) {
+                        if (!nullKeys || testBit(keyInfo.validity, i))
+                            agg.fold<Traits>(only ? *only : local[group[i - begin]], values[i].data.*Traits::member);
+                    });
+            });
+            std::lock_guard g(lock);
+            agg.merge(local);
+        });
+        agg.stale = false;
+        info.aggregatesDirty = true;
+
+        return "";
+    }
+
+    Aggregate* findAggregate(std::string const& value, std::string const& key) {
+        for (auto&& agg : tables[table].aggregates)
+            if (agg.value == value && agg.key == key)
+                return &agg;
+        return nullptr;
+    }
+
+    // deletes and updates are not folded in, the next read rebuilds instead
+    void staleAggregates(std::string const& column) {
+        for (auto&& agg : tables[table].aggregates)
+            if (column.empty() || agg.value == column || agg.key == column) {
+                agg.stale = true;
+                tables[table].aggregatesDirty = true;
+            }
+    }
+
+    // calls fn(row) for the rows of [begin, end) of a column that are not deleted
+    // (and not null when skipNull is set), deciding 64 rows per word; begin must
+    // be a multiple of 64
+    template <typename F>
+    void forEachLive(ColumnInfo const& info, RowBitmap const& deleted, bool skipNull, std::uint64_t begin, std::uint64_t end, F&& fn) {
+        std::vector<std::uint64_t> dead(RowBitmap::chunkRows / 64);
+        for (auto w = begin; w < end; w += 64) {
+            if (w == begin || w % RowBitmap::chunkRows == 0)
+                deleted.fillChunk(w, dead.data());
+            auto live = ~dead[(w % RowBitmap::chunkRows) >> 6];
+            if (skipNull && info.nullable)
+                live &= (w >> 6) < info.validity.size() ? info.validity[w >> 6] : 0;
+            if (end - w < 64)
+                live &= (std::uint64_t(1) << (end - w)) - 1;
+            for (; live != 0; live &= live - 1)
+                fn(w + std::countr_zero(live));
+        }
+    }
+
+    // serializes the member of every loaded row (in ordering if sorted) into the
+    // payload, fixed width values go straight into their slot one morsel per task
+    template <typename Traits>
+    void sendValues() {
+        constexpr auto member = Traits::member;
+        if constexpr (!Traits::fixedWidth) {
+            if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.*member, payload); }
+            else { for (auto&& x : data) serialize(x.data.*member, payload); }
+            return;
+        }
+        using T = typename Traits::type;
+        auto n = ordering.empty() ? data.size() : ordering.size();
+        auto base = payload.size();
+        payload.resize(base + n * sizeof(T));
+        workers.parallelFor(n, [&](std::uint64_t begin, std::uint64_t end) {
+            auto out = payload.data() + base + begin * sizeof(T);
+            if (!ordering.empty())
+                for (auto i = begin; i < end; i++, out += sizeof(T))
+                    memcpy(out, &(data[ordering[i]].data.*member), sizeof(T));
+            else
+                for (auto i = begin; i < end; i++, out += sizeof(T))
+                    memcpy(out, &(data[i].data.*member), sizeof(T));
+        });
+    }
+
+    // sorts [first, first + n), each morsel in parallel, then merges neighbouring
+    // runs pairwise, doubling the run width every pass
+    template <typename It, typename Less>
+    void parallelSort(It first, std::uint64_t n, Less less) {
+        workers.parallelFor(n, [&](std::uint64_t begin, std::uint64_t end) {
+            std::sort(first + begin, first + end, less);
+        });
+        for (std::uint64_t width = morselRows; width < n; width *= 2) {
+            auto runs = (n + 2 * width - 1) / (2 * width);
+            workers.parallelFor(runs, [&](std::uint64_t begin, std::uint64_t end) {
+                for (auto r = begin; r < end; r++) {
+                    auto lo = r * 2 * width;
+                    auto mid = std::min(lo + width, n);
+                    auto hi = std::min(lo + 2 * width, n);
+                    std::inplace_merge(first + lo, first + mid, first + hi, less);
+                }
+            }, 1);
+        }
+    }
+
+    // sorts the first n entries of ordering by the values they point at
+    template <typename Traits>
+    void sortBy(std::uint64_t n) {
+        constexpr auto member = Traits::member;
+        parallelSort(ordering.begin(), n, [&](std::uint64_t l, std::uint64_t r){ return data[l].data.*member < data[r].data.*member; });
+    }
+
+    // merges sorted runs spilled to files k ways into put, reading each run
+    // through a buffer of bufferRows values; put returns false to stop early
+    template <typename Stored, typename Put>
+    std::string mergeFiles(std::vector<std::string> const& files, std::vector<std::uint64_t> const& sizes, std::uint64_t bufferRows, Put&& put) {
+        struct Reader {
+            FILE* f = nullptr;
+            std::vector<Stored> buffer;
+            std::uint64_t at = 0;
+            std::uint64_t left = 0;
+        };
+        std::vector<Reader> readers(files.size());
+        auto refill = [&](Reader& r) {
+            r.buffer.resize(std::min(bufferRows, r.left));
+            r.at = 0;
+            r.left -= r.buffer.size();
+            return fread(r.buffer.data(), sizeof(Stored), r.buffer.size(), r.f) == r.buffer.size();
+        };
+
+        using Head = std::pair<Stored, std::size_t>;
+        auto greater = [](Head const& l, Head const& r) { return r.first < l.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+        std::string error;
+        for (std::size_t i = 0; i < files.size() && error.empty(); i++) {
+            readers[i].left = sizes[i];
+            if ((readers[i].f = fopen(files[i].c_str(), "rb")) == nullptr || !refill(readers[i]))
+                error = "Cannot read sort run " + files[i];
+            else if (!readers[i].buffer.empty())
+                heads.push({ readers[i].buffer[0], i });
+        }
+
+        while (error.empty() && !heads.empty()) {
+            auto [x, i] = heads.top();
+            heads.pop();
+            if (!put(x))
+                break;
+            auto& r = readers[i];
+            if (++r.at == r.buffer.size()) {
+                if (r.left == 0)
+                    continue;
+                if (!refill(r)) {
+                    error = "Cannot read sort run " + files[i];
+                    break;
+                }
+            }
+            heads.push({ r.buffer[r.at], i });
+        }
+
+        for (auto&& r : readers)
+            if (r.f != nullptr)
+                fclose(r.f);
+        return error;
+    }
+
+    // most sort runs one merge reads at once, each one is an open file
+    static constexpr std::uint64_t mergeFanIn = 64;
+
+    // merges sorted runs spilled to files and then nulls zero placeholders onto the
+    // end of the payload, which is flushed to the output file first and again
+    // every time it fills; the run buffers share half the sort budget and what
+    // they are merged into gets the other half. a run is read at least 1024
+    // values at a time, so with more runs than the fan in (or than half the
+    // budget buffers that way) groups of them are first merged into longer
+    // runs, which are added to files so they are removed with the rest
+    template <typename T, typename Stored>
+    std::string mergeRuns(std::vector<std::string>& files, std::vector<std::uint64_t> const& sizes, std::uint64_t nulls) {
+        abortIfFails(flushPayload());
+        auto half = sortBytes / 2;
+        auto fanIn = std::clamp<std::uint64_t>(half / (1024 * sizeof(Stored)), 2, mergeFanIn);
+        auto outRows = std::max<std::uint64_t>(1024, half / sizeof(Stored));
+        // runs from first on are still to merge, each merge takes the oldest
+        // ones and queues its result behind the rest, only as many as it takes
+        // for the last merge to read fanIn runs
+        std::vector<std::string> runs = files;
+        std::vector<std::uint64_t> lengths = sizes;
+        std::size_t first = 0;
+        std::string error;
+        while (runs.size() - first > fanIn) {
+            auto k = std::min<std::size_t>(fanIn, runs.size() - first - fanIn + 1);
+            std::vector<std::string> group(runs.begin() + first, runs.begin() + first + k);
+            std::vector<std::uint64_t> groupSizes(lengths.begin() + first, lengths.begin() + first + k);
+            first += k;
+            auto name = sortRunFileName(table, column, files.size());
+            files.push_back(name);
+            FILE* out = fopen(name.c_str(), "wb");
+            if (out == nullptr)
+                return "Cannot write sort run " + name;
+            std::vector<Stored> buffer;
+            buffer.reserve(outRows);
+            auto write = [&] {
+                if (fwrite(buffer.data(), sizeof(Stored), buffer.size(), out) != buffer.size())
+                    error = "Cannot write sort run " + name;
+                buffer.clear();
+                return error.empty();
+            };
+            auto failed = mergeFiles<Stored>(group, groupSizes, std::max<std::uint64_t>(1024, half / sizeof(Stored) / k), [&](Stored x) {
+                buffer.push_back(x);
+                return buffer.size() < outRows || write();
+            });
+            if (error.empty() && (error = failed).empty())
+                write();
+            if (fclose(out) != 0 && error.empty())
+                error = "Cannot write sort run " + name;
+            abortIfFails(error);
+            std::error_code ec;
+            for (auto&& run : group)
+                std::filesystem::remove(run, ec);
+            runs.push_back(name);
+            lengths.push_back(std::accumulate(groupSizes.begin(), groupSizes.end(), std::uint64_t(0)));
+        }
+        if (verbose && first > 0)
+            std::cout << "Merged sort runs " << runs.size() - sizes.size() << " times ahead of the last " << runs.size() - first << std::endl;
+        runs.erase(runs.begin(), runs.begin() + first);
+        lengths.erase(lengths.begin(), lengths.begin() + first);
+
+        payload.resize(outRows * sizeof(T));
+        std::uint64_t filled = 0;
+        auto put = [&](T v) {
+            memcpy(payload.data() + filled * sizeof(T), &v, sizeof(T));
+            if (++filled < outRows)
+                return true;
+            if (!(error = flushPayload()).empty())
+                return false;
+            payload.resize(outRows * sizeof(T));
+            filled = 0;
+            return true;
+        };
+        auto failed = mergeFiles<Stored>(runs, lengths, std::max<std::uint64_t>(1024, half / sizeof(Stored) / runs.size()), [&](Stored x) { return put(x); });
+        if (error.empty())
+            error = failed;
+        for (; error.empty() && nulls > 0; nulls--)
+            if (!put(T{}))
+                break;
+        payload.resize(filled * sizeof(T));
+        return error;
+    }
+
+    // sends the live rows of the selected column in order, nulls last, holding
+    // about sortBytes of values at a time: the column file is cut into runs that
+    // fit the budget, each run is sorted and spilled to a file in the table
+    // directory and the runs are merged k ways straight into the output file; a
+    // column that fits is a single run and never touches the disk
+    template <typename Traits>
+    std::string sendSortedAs() {
+        using T = typename Traits::type;
+        // vector<bool> is packed, bools are sorted as bytes
+        using Stored = std::conditional_t<std::is_same_v<T, bool>, std::uint8_t, T>;
+        auto const& info = tables[table].columns[column];
+        auto const& deleted = tables[table].deleted;
+        auto filename = columnFileName(table, column);
+        FILE* f = fopen(filename.c_str(), "rb");
+        if (f == nullptr)
+            return "Cannot open column file " + filename;
+
+        // a run is held twice, raw and decoded
+        auto runRows = std::max<std::uint64_t>(4096, sortBytes / (Traits::size + sizeof(Stored))) / 64 * 64;
+        struct Spill {
+            std::vector<std::string> files;
+            ~Spill() {
+                std::error_code ec;
+                for (auto&& file : files)
+                    std::filesystem::remove(file, ec);
+            }
+        } spill;
+        std::vector<std::uint64_t> sizes;
+        std::vector<Stored> run;
+        std::vector<char> raw;
+        std::uint64_t values = 0;
+        std::string error;
+        for (std::uint64_t first = 0; first < info.count && error.empty(); first += runRows) {
+            auto rows = std::min(runRows, info.count - first);
+            raw.resize(rows * Traits::size);
+            if (fread(raw.data(), 1, raw.size(), f) != raw.size()) {
+                error = "Cannot read column file " + filename;
+                break;
+            }
+            run.clear();
+            forEachLive(info, deleted, true, first, first + rows, [&](std::uint64_t row) {
+                run.push_back(static_cast<Stored>(loadFromBytes<Traits>(raw.data() + (row - first) * Traits::size)));
+            });
+            parallelSort(run.begin(), run.size(), std::less<>{});
+            values += run.size();
+            if (first == 0 && rows == info.count)
+                break;
+
+            spill.files.push_back(sortRunFileName(table, column, sizes.size()));
+            sizes.push_back(run.size());
+            std::ofstream out(spill.files.back(), std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<char const*>(run.data()), run.size() * sizeof(Stored));
+            if (!out)
+                error = "Cannot write sort run " + spill.files.back();
+            run.clear();
+        }
+        fclose(f);
+        abortIfFails(error);
+        // the merge gets the whole budget for its buffers
+        std::vector<char>().swap(raw);
+        if (!spill.files.empty())
+            std::vector<Stored>().swap(run);
+
+        auto live = info.count - deleted.countRange(0, info.count);
+        std::vector<std::uint64_t> words;
+        if (info.nullable) {
+            setBits(words, 0, values);
+            words.resize((live + 63) / 64, 0);
+        }
+        if (verbose)
+            std::cout << "Sorted " << values << " values in " << std::max<std::size_t>(1, spill.files.size()) << " runs" << std::endl;
+
+        sendColumn(Traits::kind, live, info.nullable ? &words : nullptr, [&] {
+            // the nulls at the end keep the zero placeholder their rows hold
+            if (!spill.files.empty())
+                return static_cast<void>(error = mergeRuns<T, Stored>(spill.files, sizes, live - values));
+            auto base = payload.size();
+            payload.resize(base + live * sizeof(T), 0);
+            auto out = payload.data() + base;
+            for (auto x : run) {
+                T v = x;
+                memcpy(out, &v, sizeof(T));
+                out += sizeof(T);
+            }
+        });
+        return error;
+    }
+
+    // fails an instruction that needs a selected table or column when there is
+    // none, or the selected column is not on the selected table; also the one
+    // place string columns are turned away, nothing past it handles them
+    std::string checkSelection(Instruction const& ins) {
+        static constexpr char const* noStrings = "string columns are not supported";
+        switch (ins.kind) {
+        case InstructionKind::selectTable:
+        case InstructionKind::createTable:
+        case InstructionKind::end:
+        case InstructionKind::open:
+        case InstructionKind::close:
+        case InstructionKind::free:
+            return "";
+        case InstructionKind::createColumn:
+            if (ins.data.createColumn.type == AttributeKind::string)
+                return noStrings;
+            [[fallthrough]];
+        case InstructionKind::selectColumn:
+        case InstructionKind::deleteRow:
+            return tables.contains(table) ? "" : "No table selected";
+        case InstructionKind::importTable:
+            if (!tables.contains(table))
+                return "No table selected";
+            for (auto&& [name, info] : tables[table].columns)
+                if (info.type == AttributeKind::string)
+                    return noStrings;
+            return "";
+        default:
+            if (!tables.contains(table))
+                return "No table selected";
+            if (!tables[table].columns.contains(column))
+                return "No column selected on table " + table;
+            if (tables[table].columns[column].type == AttributeKind::string)
+                return noStrings;
+            if (ins.kind == InstructionKind::createAggregate) {
+                auto key = tables[table].columns.find(ins.data.createAggregate.key);
+                if (key != tables[table].columns.end() && key->second.type == AttributeKind::string)
+                    return noStrings;
+            }
+            return "";
+        }
+    }
+
+    // instructions that change column files, prefetched blocks read before one of
+    // these could be stale so prefetching never runs across them
+    static bool writesColumns(InstructionKind k) {
+        return k == InstructionKind::appendColumn || k == InstructionKind::appendNull || k == InstructionKind::updateRow || k == InstructionKind::importTable;
+    }
+
+    // queues a background load of every block of a column that is not cached
+    // yet, each block stays pinned in ahead until the column's read releases it
+    void prefetchColumn(std::string const& t, std::string const& c) {
+        auto count = tables[t].columns[c].count;
+        auto type = tables[t].columns[c].type;
+        if (verbose)
+            std::cout << "Prefetching: " << t << "/" << c << std::endl;
+        {
+            std::lock_guard g(aheadLock);
+            ahead[t + "/" + c].clear();
+        }
+        prefetcher.push([=, this] {
+            FILE* f = nullptr;
+            for (std::uint64_t b = 0; b * ColumnBlock::blockRows < count; b++) {
+                auto block = cache.peek(BlockCache::key(t, c, b));
+                if (block == nullptr) {
+                    if (!(block = loadBlock(t, c, b, count, type, f)))
+                        break;
+                    prefetched++;
+                }
+                std::lock_guard g(aheadLock);
+                // the read got here first and loads the rest itself
+                auto held = ahead.find(t + "/" + c);
+                if (held == ahead.end())
+                    break;
+                held->second.push_back(std::move(block));
+            }
+            if (f != nullptr)
+                fclose(f);
+        });
+    }
+
+    // unpins the blocks prefetched for a column, once its read is done or a
+    // write makes them stale
+    void releasePrefetched(std::string const& key) {
+        std::lock_guard g(aheadLock);
+        ahead.erase(key);
+    }
+
+    void releasePrefetched() {
+        std::lock_guard g(aheadLock);
+        ahead.clear();
+    }
+
+    // looks ahead from ic to the next instruction that writes columns, following
+    // the select registers, and prefetches each column read in that stretch that
+    // is not queued yet; prefetched blocks stay pinned until their read, so the
+    // columns ahead must fit the cache together, it stops at the first that does
+    // not and run plans again at every read
+    void planPrefetch(std::vector<Instruction> const& instructions, std::uint64_t ic) {
+        auto t = table;
+        auto c = column;
+        std::unordered_set<std::string> planned;
+        std::uint64_t bytes = 0;
+        for (; ic < instructions.size(); ic++) {
+            auto& ins = instructions[ic];
+            if (writesColumns(ins.kind) || ins.kind == InstructionKind::end)
+                return;
+            if (ins.kind == InstructionKind::selectTable)
+                t = ins.data.selectTable.name;
+            else if (ins.kind == InstructionKind::selectColumn)
+                c = ins.data.selectColumn.name;
+            else if (ins.kind == InstructionKind::readColumn && planned.insert(t + "/" + c).second) {
+                if (!tables.contains(t) && !loadTable(t))
+                    continue;
+                auto& info = tables[t];
+                if (!info.columns.contains(c) || info.columns[c].type == AttributeKind::string)
+                    continue;
+                bytes += info.columns[c].count * attributeSize(info.columns[c].type);
+                if (bytes > cache.capacity())
+                    return;
+                if (queued.insert(t + "/" + c).second)
+                    prefetchColumn(t, c);
+            }
+        }
+    }
+
+    // kind of the values in the data register, a read loads the selected column's
+    // kind but distinct loads a count whatever the column holds
+    AttributeKind dataType() {
+        return data.empty() ? columnType(table, column) : data.front().kind;
+    }
+
+    // every row of the data register from `from` on holds a value
+    void loadedValues(std::uint64_t from) {
+        if (!validity.empty())
+            setBits(validity, from, data.size());
+    }
+
+    // sketches the live values of the selected column, each morsel into a sketch
+    // of its own that is folded into s once the morsel is done
+    std::string scanSketch(ColumnSketch& s, bool distinct, bool quantiles) {
+        std::vector<Attribute> rows;
+        abortIfFails(loadColumn(table, column, rows));
+        auto const& info = tables[table].columns[column];
+        auto const& deleted = tables[table].deleted;
+        std::mutex lock;
+        dispatch(info.type, [&](auto t) {
+            constexpr auto m = decltype(t)::member;
+            if constexpr (decltype(t)::fixedWidth)
+                workers.parallelFor(rows.size(), [&](std::uint64_t begin, std::uint64_t end) {
+                    ColumnSketch local;
+                    forEachLive(info, deleted, true, begin, end, [&](std::uint64_t i) {
+                        auto key = orderKeyOf(rows[i].data.*m);
+                        if (distinct)
+                            local.distinct.insert(mix64(key));
+                        if (quantiles)
+                            local.quantiles.insert(key);
+                    });
+                    std::lock_guard g(lock);
+                    s.merge(local);
+                });
+        });
+        return "";
+    }
+
+    // appends rows [first, first + rows) of a column, which must lie in one block,
+    // out of its block (cached or read and cached)
+    std::string readRows(std::string const& table, std::string const& column, FILE*& f, std::uint64_t first, std::uint64_t rows, std::vector<Attribute>& out) {
+        auto const& info = tables[table].columns[column];
+        auto b = first / ColumnBlock::blockRows;
+        auto block = loadBlock(table, column, b, info.count, info.type, f);
+        if (!block)
+            return "Cannot read column file " + columnFileName(table, column);
+        auto at = first - b * ColumnBlock::blockRows;
+        auto n = out.size();
+        out.resize(n + rows);
+        dispatch(info.type, [&](auto t) {
+            using Traits = decltype(t);
+            if constexpr (Traits::fixedWidth)
+                for (std::uint64_t i = 0; i < rows; i++) {
+                    out[n + i].kind = Traits::kind;
+                    out[n + i].data.*Traits::member = block->at<Traits>(at + i);
+                }
+        });
+        return "";
+    }
+
+    // loads n live values of the selected column picked uniformly at random, in row
+    // order; the number of live rows is known up front so Floyd's selection of n
+    // ranks stands in for a streaming reservoir and only the picked values are read
+    std::string sampleRows(std::uint64_t n) {
+        auto const& info = tables[table].columns[column];
+        auto const& deleted = tables[table].deleted;
+        std::uint64_t live = 0;
+        forEachLive(info, deleted, true, 0, info.count, [&](std::uint64_t) { live++; });
+        n = std::min(n, live);
+
+        std::unordered_set<std::uint64_t> chosen;
+        for (auto j = live - n; j < live; j++)
+            if (!chosen.insert(std::uniform_int_distribution<std::uint64_t>(0, j)(random)).second)
+                chosen.insert(j);
+        std::vector<std::uint64_t> ranks(chosen.begin(), chosen.end());
+        std::sort(ranks.begin(), ranks.end());
+
+        std::vector<std::uint64_t> rows;
+        rows.reserve(n);
+        std::uint64_t rank = 0;
+        forEachLive(info, deleted, true, 0, info.count, [&](std::uint64_t row) {
+            if (rows.size() < ranks.size() && ranks[rows.size()] == rank)
+                rows.push_back(row);
+            rank++;
+        });
+
+        FILE* f = nullptr;
+        std::string error;
+        data.reserve(data.size() + rows.size());
+        for (auto row : rows) {
+            Attribute x;
+            if (!readValue(table, column, f, row, x)) {
+                error = "Cannot read column file " + columnFileName(table, column);
+                break;
+            }
+            data.push_back(x);
+        }
+        if (f != nullptr)
+            fclose(f);
+        return error;
+    }
+
+    // loads about n live values of the selected column as whole runs of rows taken
+    // at random, a run is a slice of one block so this touches far fewer blocks
+    // than a row sample at the cost of clustering
+    std::string sampleBlocks(std::uint64_t n) {
+        static constexpr std::uint64_t runRows = 4096;
+        auto const& info = tables[table].columns[column];
+        auto const& deleted = tables[table].deleted;
+        std::vector<std::uint64_t> runs((info.count + runRows - 1) / runRows);
+        std::iota(runs.begin(), runs.end(), 0);
+        std::shuffle(runs.begin(), runs.end(), random);
+
+        FILE* f = nullptr;
+        std::string error;
+        std::vector<Attribute> rows;
+        std::uint64_t taken = 0;
+        for (auto r : runs) {
+            if (taken >= n)
+                break;
+            auto first = r * runRows;
+            auto count = std::min(runRows, info.count - first);
+            rows.clear();
+            if (!(error = readRows(table, column, f, first, count, rows)).empty())
+                break;
+            forEachLive(info, deleted, true, first, first + count, [&](std::uint64_t row) {
+                if (taken < n) {
+                    data.push_back(rows[row - first]);
+                    taken++;
+                }
+            });
+        }
+        if (f != nullptr)
+            fclose(f);
+        return error;
+    }
+
+    // offset in the output of the end of the payload
+    std::uint64_t payloadEnd() {
+        return flushed + payload.size();
+    }
+
+    void padPayload() {
+        payload.resize(payload.size() + (columnarAlignment - payloadEnd() % columnarAlignment) % columnarAlignment, 0);
+    }
+
+    // overwrites the bytes at output offset at, in the output file when they were
+    // flushed already
+    template <typename T>
+    void patch(std::uint64_t at, T const& x) {
+        if (at >= flushed)
+            return static_cast<void>(memcpy(payload.data() + (at - flushed), &x, sizeof(T)));
+        fseek(dump, at, SEEK_SET);
+        fwrite(&x, sizeof(T), 1, dump);
+        fseek(dump, 0, SEEK_END);
+    }
+
+    std::string dumpPartFileName() {
+        return dumpFile + ".part";
+    }
+
+    // moves the payload built so far to the output file, so a send larger than
+    // memory can stream after it; the file is written next to dumpFile and only
+    // renamed over it once the program succeeds
+    std::string flushPayload() {
+        if (dump == nullptr && (dump = fopen(dumpPartFileName().c_str(), "wb")) == nullptr)
+            return "Cannot open output file " + dumpPartFileName();
+        if (fwrite(payload.data(), 1, payload.size(), dump) != payload.size())
+            return "Cannot write output file " + dumpPartFileName();
+        flushed += payload.size();
+        payload.clear();
+        return "";
+    }
+
+    // validity words of the count rows about to be sent, in send order
+    std::vector<std::uint64_t> sentValidity(std::uint64_t count) {
+        std::vector<std::uint64_t> words((count + 63) / 64, 0);
+        if (ordering.empty())
+            std::copy(validity.begin(), validity.begin() + std::min(words.size(), validity.size()), words.begin());
+        else
+            for (std::uint64_t i = 0; i < count; i++)
+                words[i >> 6] |= std::uint64_t(testBit(validity, ordering[i])) << (i & 63);
+        if (count & 63)
+            words.back() &= (std::uint64_t(1) << (count & 63)) - 1;
+        return words;
+    }
+
+    // writes one column of count values to the payload as a frame or a columnar
+    // record (descriptor, validity, values, each starting on a 64 byte boundary),
+    // words is null when every row holds a value and values appends the values
+    void sendColumn(AttributeKind type, std::uint64_t count, std::vector<std::uint64_t> const* words, std::function<void()> const& values) {
+        if (format == OutputFormat::frames) {
+            serialize(column, payload);
+            serialize(static_cast<byte>(static_cast<byte>(type) | (words ? nullableFlag : 0)), payload);
+            serialize(count, payload);
+            if (words)
+                for (auto w : *words)
+                    serialize(w, payload);
+            return values();
+        }
+
+        auto start = payloadEnd();
+        serialize(std::uint64_t(0), payload); // record length
+        serialize(static_cast<byte>(type), payload);
+        serialize(static_cast<byte>(words != nullptr), payload);
+        serialize(static_cast<std::uint16_t>(table.size()), payload);
+        serialize(static_cast<std::uint16_t>(column.size()), payload);
+        serialize(std::uint16_t(0), payload);
+        serialize(count, payload);
+        serialize(std::uint64_t(0), payload); // validity offset
+        serialize(std::uint64_t(0), payload); // values offset
+        serialize(std::uint64_t(0), payload); // values length
+        std::copy(table.begin(), table.end(), std::back_inserter(payload));
+        std::copy(column.begin(), column.end(), std::back_inserter(payload));
+        padPayload();
+
+        if (words) {
+            patch(start + 24, payloadEnd());
+            for (auto w : *words)
+                serialize(w, payload);
+            padPayload();
+        }
+
+        auto at = payloadEnd();
+        values();
+        patch(start + 32, at);
+        patch(start + 40, payloadEnd() - at);
+        padPayload();
+        patch(start, payloadEnd() - start);
+
+        columnsSent++;
+    }
+
+public:
+    DataBase(std::string const& dumpFile, std::uint64_t cacheBytes = std::uint64_t(1) << 30, OutputFormat format = OutputFormat::frames, std::uint64_t sortBytes = std::uint64_t(1) << 30) : dumpFile(dumpFile), cache(cacheBytes), format(format), sortBytes(sortBytes) {}
+
+    void clearState() {
+        table = "";
+        column = "";
+        ordering.clear();
+        data.clear();
+        validity.clear();
+        payload.clear();
+        flushed = 0;
+        data.shrink_to_fit();
+        payload.shrink_to_fit();
+    }
+
+    std::string createTable(std::string const& name) {
+        if (tables.contains(name) || std::filesystem::exists(catalogFileName(name)))
+            return "Table: " + name + " already exists";
+
+        tables[name] = TableInfo();
+        createTableFile(name);
+
+        return "";
+    }
+
+    std::string createColumn(std::string const& name, AttributeKind const& type, bool nullable) {
+        if (tables[table].columns.contains(name))
+            return "Column: " + name + " already exists on table" + table;
+
+        tables[table].columns[name] = ColumnInfo(type, 0, nullable);
+        tables[table].order.push_back(name);
+
+        createColumnFile(table, name);
+        
+        return "";
+    }
+
+    std::string selectTable(std::string const& name) {
+        if (!tables.contains(name) && !loadTable(name))
+            return "Cannot select an non existent table named: " + name;
+        
+        table = name;
+
+        return "";
+    }
+
+    std::string selectColumn(std::string const& name) {
+        if (!tables[table].columns.contains(name))
+            return "Cannot select an non existent column named: " + name + " on table " + table;
+        
+        column = name;
+
+        return "";
+    }  
+
+    std::string readColumn() {
+        auto n = data.size();
+        auto& deleted = tables[table].deleted;
+        abortIfFails(loadColumn(table, column, data, &deleted));
+
+        auto& info = tables[table].columns[column];
+        if (!info.nullable && validity.empty())
+            return "";
+        if (validity.empty())
+            setBits(validity, 0, n);
+        if (!info.nullable)
+            setBits(validity, n, data.size());
+        else {
+            validity.resize((data.size() + 63) / 64, 0);
+            auto o = n;
+            forEachLive(info, deleted, false, 0, info.count, [&](std::uint64_t row) {
+                if (testBit(info.validity, row))
+                    validity[o >> 6] |= std::uint64_t(1) << (o & 63);
+                o++;
+            });
+        }
+
+        return "";
+    }
+
+    std::string appendColumn(Attribute const& attr) {
+        Attribute value;
+        abortIfFails(convertAttr(attr, columnType(table, column), value));
+
+        auto f = appendColumnFile(table, column);
+        if (!f)
+            return "Cannot open column file " + columnFileName(table, column);
+        writeAttr(f, value);
+
+        maintainAppend(table, column, columnCount(table, column), value);
+
+        auto& info = tables[table].columns[column];
+        if (info.nullable) {
+            setBits(info.validity, info.count, info.count + 1);
+            info.validityDirty = true;
+        }
+
+        cache.invalidate(BlockCache::key(table, column, columnCount(table, column) / ColumnBlock::blockRows));
+        addColumnCount(table, column, 1);
+
+        return "";
+    }
+
+    // appends a zeroed placeholder and leaves the row's validity bit clear
+    std::string appendNull() {
+        auto& info = tables[table].columns[column];
+        if (!info.nullable)
+            return "Cannot append null to column " + column + ", it is not nullable";
+
+        Attribute zero, value;
+        zero.data.u64 = 0;
+        abortIfFails(convertAttr(zero, info.type, value));
+
+        auto f = appendColumnFile(table, column);
+        if (!f)
+            return "Cannot open column file " + columnFileName(table, column);
+        writeAttr(f, value);
+
+        info.validity.resize((info.count + 64) / 64, 0);
+        info.validityDirty = true;
+
+        cache.invalidate(BlockCache::key(table, column, info.count / ColumnBlock::blockRows));
+        addColumnCount(table, column, 1);
+
+        return "";
+    }
+
+    // puts every column of the selected table back to the row count it had before
+    // a failed import, files, validity and indexes included; aggregates that took
+    // some of the dropped rows are rebuilt by their next read
+    void truncateColumns(std::unordered_map<std::string, std::uint64_t> const& counts) {
+        auto& info = tables[table];
+        for (auto&& [name, count] : counts) {
+            auto& col = info.columns[name];
+            if (col.count == count)
+                continue;
+            std::error_code ec;
+            std::filesystem::resize_file(columnFileName(table, name), count * attributeSize(col.type), ec);
+            col.count = count;
+            if (col.nullable) {
+                col.validity.resize((count + 63) / 64, 0);
+                if (count & 63)
+                    col.validity.back() &= (std::uint64_t(1) << (count & 63)) - 1;
+                col.validityDirty = true;
+            }
+            if (col.index)
+                col.index->truncate(count);
+            cache.invalidateColumn(table, name);
+        }
+        staleAggregates("");
+    }
+
+    // loads a whole table from a csv file (header line naming the columns, empty
+    // fields are null) or a binary file of packed little endian rows in column
+    // creation order; the file is read in large chunks cut at row boundaries,
+    // every chunk is parsed by the pool into per column buffers and each buffer
+    // is appended to its column file with one write. all or nothing: a chunk that
+    // fails to parse or write truncates the table back to where it started and
+    // sketches only take the imported values once every chunk is in
+    std::string importTable(ImportFormat format, std::string const& filename) {
+        auto& info = tables[table];
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+            return "Cannot open import file " + filename;
+
+        std::vector<ColumnInfo*> columns;
+        std::vector<std::string> names;
+        std::uint64_t recordSize = 0;
+        if (format == ImportFormat::csv) {
+            std::string header;
+            std::getline(in, header);
+            if (!header.empty() && header.back() == '\r')
+                header.pop_back();
+            names = split(header, ',');
+            for (auto&& name : names) {
+                if (!info.columns.contains(name))
+                    return "Cannot import unknown column " + name + " into table " + table;
+                if (std::count(names.begin(), names.end(), name) > 1)
+                    return "Cannot import " + filename + ", it names column " + name + " twice";
+                columns.push_back(&info.columns[name]);
+            }
+            for (auto&& name : info.order)
+                if (std::find(names.begin(), names.end(), name) == names.end() && !info.columns[name].nullable)
+                    return "Cannot import " + filename + ", it has no values for column " + name + " which is not nullable";
+        }
+        else {
+            names = info.order;
+            for (auto&& name : names)
+                columns.push_back(&info.columns[name]);
+        }
+        if (columns.empty())
+            return "Cannot import " + filename + ", it has no columns of table " + table;
+        // each column's field parser and width, picked once so parsing a field
+        // is a plain call
+        std::vector<bool (*)(std::string_view, char*)> parsers;
+        std::vector<std::uint64_t> sizes;
+        for (auto c : columns)
+            dispatch(c->type, [&](auto t) {
+                parsers.push_back(&parseField<decltype(t)>);
+                sizes.push_back(decltype(t)::size);
+            });
+        if (format == ImportFormat::binary) {
+            recordSize = std::accumulate(sizes.begin(), sizes.end(), std::uint64_t(0));
+            std::error_code ec;
+            auto size = std::filesystem::file_size(filename, ec);
+            if (ec)
+                return "Cannot open import file " + filename;
+            if (size % recordSize != 0)
+                return "Cannot import " + filename + ", its size is not a multiple of the " + std::to_string(recordSize) + " byte row";
+        }
+
+        // what one piece of a chunk parses to
+        struct Piece {
+            std::vector<bytes> values;
+            std::vector<std::vector<std::uint64_t>> validity;
+            std::uint64_t rows = 0;
+            std::string error;
+        };
+
+        std::uint64_t const chunkBytes = std::uint64_t(64) << 20;
+        std::vector<std::string> absent;
+        for (auto&& name : info.order)
+            if (std::find(names.begin(), names.end(), name) == names.end())
+                absent.push_back(name);
+
+        std::unordered_map<std::string, std::uint64_t> start;
+        for (auto&& [name, col] : info.columns)
+            start[name] = col.count;
+        std::vector<std::unique_ptr<ColumnSketch>> sketches(columns.size());
+        for (std::size_t c = 0; c < columns.size(); c++)
+            if (columns[c]->sketch)
+                sketches[c] = std::make_unique<ColumnSketch>();
+
+        std::string error;
+        std::string carry;
+        std::vector<char> buffer;
+        while (error.empty() && (in || !carry.empty())) {
+            buffer.assign(carry.begin(), carry.end());
+            auto have = buffer.size();
+            buffer.resize(have + chunkBytes);
+            in.read(buffer.data() + have, chunkBytes);
+            buffer.resize(have + in.gcount());
+            if (buffer.empty())
+                break;
+
+            // keep the trailing partial row for the next chunk
+            std::uint64_t usable = buffer.size();
+            if (in) {
+                if (format == ImportFormat::csv) {
+                    auto nl = std::string_view(buffer.data(), buffer.size()).find_last_of('\n');
+                    usable = nl == std::string_view::npos ? 0 : nl + 1;
+                }
+                else
+                    usable -= usable % recordSize;
+            }
+            carry.assign(buffer.begin() + usable, buffer.end());
+
+            // cut the chunk into one piece per worker at row boundaries
+            std::vector<std::uint64_t> cuts{ 0 };
+            auto pieces = workers.size() * 4;
+            for (std::uint64_t p = 1; p < pieces; p++) {
+                auto at = std::max(cuts.back(), usable * p / pieces);
+                if (format == ImportFormat::csv) {
+                    while (at < usable && at > 0 && buffer[at - 1] != '\n')
+                        at++;
+                }
+                else
+                    at -= at % recordSize;
+                cuts.push_back(at);
+            }
+            cuts.push_back(usable);
+
+            std::vector<Piece> parsed(pieces);
+            workers.parallelFor(pieces, [&](std::uint64_t begin, std::uint64_t end) {
+                for (auto p = begin; p < end; p++) {
+                    auto& piece = parsed[p];
+                    piece.values.resize(columns.size());
+                    piece.validity.resize(columns.size());
+                    char const* b = buffer.data() + cuts[p];
+                    char const* e = buffer.data() + cuts[p + 1];
+                    if (format == ImportFormat::binary) {
+                        piece.rows = (e - b) / recordSize;
+                        std::uint64_t offset = 0;
+                        for (std::size_t c = 0; c < columns.size(); c++) {
+                            auto s = sizes[c];
+                            piece.values[c].resize(piece.rows * s);
+                            for (std::uint64_t r = 0; r < piece.rows; r++)
+                                memcpy(piece.values[c].data() + r * s, b + r * recordSize + offset, s);
+                            setBits(piece.validity[c], 0, piece.rows);
+                            offset += s;
+                        }
+                        continue;
+                    }
+                    while (b < e) {
+                        auto lineEnd = std::find(b, e, '\n');
+                        std::string_view line(b, lineEnd - b);
+                        b = lineEnd + (lineEnd != e);
+                        if (!line.empty() && line.back() == '\r')
+                            line.remove_suffix(1);
+                        if (line.empty())
+                            continue;
+                        // a line must have exactly one field per header column
+                        auto fields = [&] {
+                            piece.error = "Cannot import " + filename + ", line '" + std::string(line) + "' has " + std::to_string(std::count(line.begin(), line.end(), ',') + 1) + " fields but the header names " + std::to_string(columns.size()) + " columns";
+                        };
+                        std::size_t at = 0;
+                        for (std::size_t c = 0; c < columns.size(); c++) {
+                            if (at > line.size())
+                                return fields();
+                            auto comma = std::min(line.find(',', at), line.size());
+                            auto field = line.substr(at, comma - at);
+                            at = comma + 1;
+                            auto s = sizes[c];
+                            auto& out = piece.values[c];
+                            out.resize(out.size() + s, 0);
+                            if (field.empty()) {
+                                if (!columns[c]->nullable) {
+                                    piece.error = "Cannot import an empty value into column " + names[c] + ", it is not nullable";
+                                    return;
+                                }
+                                piece.validity[c].resize((piece.rows + 64) / 64, 0);
+                                continue;
+                            }
+                            if (!parsers[c](field, reinterpret_cast<char*>(out.data() + out.size() - s))) {
+                                piece.error = "Cannot import '" + std::string(field) + "' into column " + names[c] + " of type " + str(columns[c]->type);
+                                return;
+                            }
+                            setBits(piece.validity[c], piece.rows, piece.rows + 1);
+                        }
+                        if (at <= line.size())
+                            return fields();
+                        piece.rows++;
+                    }
+                }
+            }, 1);
+
+            for (auto&& piece : parsed)
+                if (error.empty())
+                    error = piece.error;
+            if (!error.empty())
+                break;
+
+            std::unordered_map<std::string, std::uint64_t> before;
+            for (auto&& [name, col] : info.columns)
+                before[name] = col.count;
+
+            for (std::size_t c = 0; c < columns.size(); c++) {
+                auto& col = *columns[c];
+                auto f = appendColumnFile(table, names[c]);
+                std::vector<ColumnIndex::Entry> entries;
+                for (auto&& piece : parsed) {
+                    f.write(reinterpret_cast<char const*>(piece.values[c].data()), piece.values[c].size());
+                    auto first = col.count;
+                    col.count += piece.rows;
+                    auto const& valid = piece.validity[c];
+                    if (col.nullable) {
+                        for (std::uint64_t r = 0; r < piece.rows; r++)
+                            if (testBit(valid, r))
+                                setBits(col.validity, first + r, first + r + 1);
+                        col.validity.resize((col.count + 63) / 64, 0);
+                        col.validityDirty = true;
+                    }
+                    if (!col.index && !col.sketch)
+                        continue;
+                    // the kind is picked once per piece, every row is a typed load
+                    dispatch(col.type, [&](auto t) {
+                        using Traits = decltype(t);
+                        if constexpr (Traits::fixedWidth) {
+                            auto values = reinterpret_cast<char const*>(piece.values[c].data());
+                            for (std::uint64_t r = 0; r < piece.rows; r++) {
+                                if (col.nullable && !testBit(valid, r))
+                                    continue;
+                                auto key = orderKeyOf(loadFromBytes<Traits>(values + r * Traits::size));
+                                if (col.index)
+                                    entries.push_back({ key, first + r });
+                                if (col.sketch)
+                                    sketches[c]->insert(key);
+                            }
+                        }
+                    });
+                }
+                if (col.index)
+                    col.index->insertBatch(entries);
+                cache.invalidateColumn(table, names[c]);
+                if (!f)
+                    error = "Cannot write column file " + columnFileName(table, names[c]);
+            }
+
+            // columns the csv does not mention are nullable, pad them with nulls
+            std::uint64_t rows = 0;
+            for (auto&& piece : parsed)
+                rows += piece.rows;
+            for (auto&& name : absent) {
+                auto& col = info.columns[name];
+                auto f = appendColumnFile(table, name);
+                std::vector<char> zeros(rows * attributeSize(col.type), 0);
+                f.write(zeros.data(), zeros.size());
+                col.count += rows;
+                col.validity.resize((col.count + 63) / 64, 0);
+                col.validityDirty = true;
+                cache.invalidateColumn(table, name);
+                if (!f)
+                    error = "Cannot write column file " + columnFileName(table, name);
+            }
+            if (!error.empty())
+                break;
+
+            // an aggregate takes every row the chunk completed, one that now has
+            // both its value and its key; both come straight out of the pieces
+            // unless the columns had drifted to different lengths, then the half
+            // that predates the chunk is read back
+            std::vector<std::uint64_t> starts{ 0 };
+            for (auto&& piece : parsed)
+                starts.push_back(starts.back() + piece.rows);
+            // where the rows of one column come from, names.size() for a column
+            // the csv leaves out, which was padded with nulls
+            struct Source {
+                std::string const* name;
+                std::size_t c;
+                std::uint64_t before;
+            };
+            auto source = [&](std::string const& name) {
+                return Source{ &name, static_cast<std::size_t>(std::find(names.begin(), names.end(), name) - names.begin()), before[name] };
+            };
+            auto at = [&](Source const& s, std::uint64_t row, Attribute& x) {
+                if (row < s.before)
+                    return valueAt(table, *s.name, row, x);
+                if (s.c == names.size())
+                    return false;
+                auto i = row - s.before;
+                auto p = std::upper_bound(starts.begin(), starts.end(), i) - starts.begin() - 1;
+                auto& piece = parsed[p];
+                i -= starts[p];
+                if (!testBit(piece.validity[s.c], i))
+                    return false;
+                x.kind = columns[s.c]->type;
+                loadAttrDataFromBytes(x, reinterpret_cast<char*>(piece.values[s.c].data() + i * attributeSize(x.kind)));
+                return true;
+            };
+            for (auto&& agg : info.aggregates) {
+                auto value = source(agg.value);
+                auto key = source(agg.key.empty() ? agg.value : agg.key);
+                auto from = std::min(value.before, key.before);
+                auto to = std::min(info.columns[agg.value].count, info.columns[*key.name].count);
+                if (agg.stale || from >= to)
+                    continue;
+                info.aggregatesDirty = true;
+                if (value.before != key.before || value.c == names.size() || key.c == names.size()) {
+                    for (auto row = from; row < to; row++) {
+                        Attribute v, k;
+                        if (!info.deleted.contains(row) && at(value, row, v) && at(key, row, k))
+                            agg.fold(agg.key.empty() ? 0 : orderKey(k), v);
+                    }
+                    continue;
+                }
+                // both columns were in step and came from the csv, so the rows
+                // are exactly the pieces' and each piece folds with typed loops
+                for (std::size_t p = 0; p < parsed.size(); p++) {
+                    auto const& piece = parsed[p];
+                    auto first = from + starts[p];
+                    std::unordered_map<std::uint64_t, Aggregate::Totals> local;
+                    std::vector<std::uint64_t> group(piece.rows, 0);
+                    if (!agg.key.empty())
+                        dispatch(columns[key.c]->type, [&](auto t) {
+                            using Traits = decltype(t);
+                            if constexpr (Traits::fixedWidth) {
+                                auto b = reinterpret_cast<char const*>(piece.values[key.c].data());
+                                for (std::uint64_t i = 0; i < piece.rows; i++)
+                                    group[i] = orderKeyOf(loadFromBytes<Traits>(b + i * Traits::size));
+                            }
+                        });
+                    dispatch(columns[value.c]->type, [&](auto t) {
+                        using Traits = decltype(t);
+                        if constexpr (Traits::fixedWidth) {
+                            auto b = reinterpret_cast<char const*>(piece.values[value.c].data());
+                            for (std::uint64_t i = 0; i < piece.rows; i++)
+                                if (testBit(piece.validity[value.c], i) && testBit(piece.validity[key.c], i) && !info.deleted.contains(first + i))
+                                    agg.fold<Traits>(local[group[i]], loadFromBytes<Traits>(b + i * Traits::size));
+                        }
+                    });
+                    agg.merge(local);
+                }
+            }
+        }
+
+        if (!error.empty()) {
+            truncateColumns(start);
+            return error;
+        }
+        for (std::size_t c = 0; c < columns.size(); c++)
+            if (sketches[c])
+                columns[c]->sketch->merge(*sketches[c]);
+
+        return "";
+    }
+
+    std::string deleteRow(std::uint64_t row) {
+        if (row >= tableRowCount(table))
+            return "Cannot delete row " + std::to_string(row) + " of table " + table + ", it only has " + std::to_string(tableRowCount(table)) + " rows";
+
+        auto& info = tables[table];
+        info.deletedDirty |= info.deleted.add(row);
+        staleAggregates("");
+
+        return "";
+    }
+
+    // tombstones every row of the selected column matching `<column> op value`
+    std::string deleteWhere(CompareOp op, Attribute const& literal) {
+        auto type = columnType(table, column);
+        if (literal.kind == AttributeKind::string)
+            return "Cannot compare column " + column + " with a string";
+        // the predicate is rewritten against a value of the column's kind, one
+        // the kind cannot hold matches every row or none
+        Attribute below, above, value;
+        auto hasBelow = roundAttr(literal, type, false, below);
+        auto hasAbove = roundAttr(literal, type, true, above);
+        auto exact = hasBelow && hasAbove && orderKey(below) == orderKey(above);
+        std::optional<bool> every;
+        switch (op) {
+        case CompareOp::eq: if (!exact) every = false; value = below; break;
+        case CompareOp::ne: if (!exact) every = true; value = below; break;
+        case CompareOp::lt: if (!hasAbove) every = true; value = above; break;
+        case CompareOp::ge: if (!hasAbove) every = false; value = above; break;
+        case CompareOp::le: if (!hasBelow) every = false; value = below; break;
+        case CompareOp::gt: if (!hasBelow) every = true; value = below; break;
+        }
+        if (every == false)
+            return "";
+
+        std::vector<Attribute> rows;
+        abortIfFails(loadColumn(table, column, rows));
+
+        auto morsels = (rows.size() + morselRows - 1) / morselRows;
+        std::vector<std::vector<std::uint64_t>> hits(morsels);
+        auto const& col = tables[table].columns[column];
+        auto const& deleted = tables[table].deleted;
+        dispatch(type, [&](auto t) {
+            dispatch(op, [&](auto pred) {
+                constexpr auto m = decltype(t)::member;
+                auto const& v = value.data.*m;
+                auto all = every.value_or(false);
+                // null rows never match
+                workers.parallelFor(rows.size(), [&](std::uint64_t begin, std::uint64_t end) {
+                    auto& h = hits[begin / morselRows];
+                    forEachLive(col, deleted, true, begin, end, [&](std::uint64_t i) {
+                        if (all || pred(rows[i].data.*m, v))
+                            h.push_back(i);
+                    });
+                });
+            });
+        });
+
+        auto& info = tables[table];
+        for (auto&& h : hits)
+            for (auto row : h)
+                info.deletedDirty |= info.deleted.add(row);
+        staleAggregates("");
+
+        return "";
     }
 
-    void readAttributes(FILE* fd, std::vector<Attribute>& d, std::uint64_t count, AttributeKind type) {
-        auto n = d.size();
-        d.resize(n + count);
-        auto s = attributeSize(type);
-        auto ss = s * count;
-        char* b = new char[ss];
-        fread(b, 1, ss, fd);
+    // overwrites a single fixed width value of the selected column in place
+    std::string updateRow(std::uint64_t row, Attribute const& literal) {
+        auto type = columnType(table, column);
+        if (row >= columnCount(table, column))
+            return "Cannot update row " + std::to_string(row) + " of column " + column + ", it only has " + std::to_string(columnCount(table, column)) + " rows";
+        if (tables[table].deleted.contains(row))
+            return "Cannot update deleted row " + std::to_string(row) + " of table " + table;
+
+        Attribute value;
+        abortIfFails(convertAttr(literal, type, value));
 
-        std::uint64_t j = 0;
-        for (auto i = n; i < n + count; i++, j += s) {
-            d[i].kind = type;
-            loadAttrDataFromBytes(d[i], b + j);
+        auto f = updateColumnFile(table, column);
+        if (!f)
+            return "Cannot open column file " + columnFileName(table, column);
+        if (auto index = columnIndex(table, column)) {
+            char b[8];
+            Attribute old;
+            old.kind = type;
+            f.seekg(row * attributeSize(type));
+            f.read(b, attributeSize(type));
+            loadAttrDataFromBytes(old, b);
+            index->erase(orderKey(old), row);
+            index->insert(orderKey(value), row);
         }
+        if (auto& sketch = tables[table].columns[column].sketch)
+            sketch->insert(orderKey(value));
+        staleAggregates(column);
+        f.seekp(row * attributeSize(type));
+        writeAttr(f, value);
+        cache.invalidate(BlockCache::key(table, column, row / ColumnBlock::blockRows));
 
-        delete[] b;
+        if (auto& info = tables[table].columns[column]; info.nullable) {
+            setBits(info.validity, row, row + 1);
+            info.validityDirty = true;
+        }
+
+        return "";
     }
 
-public:
-    DataBase(std::string const& dumpFile) : dumpFile(dumpFile) {}
+    std::string createIndex() {
+        auto type = columnType(table, column);
 
-    void clearState() {
-        table = "";
-        column = "";
-        ordering.clear();
-        data.clear();
-        payload.clear();
-        data.shrink_to_fit();
-        payload.shrink_to_fit();
-    }
+        std::vector<Attribute> rows;
+        abortIfFails(loadColumn(table, column, rows));
 
-    std::string createTable(std::string const& name) {
-        if (tables.contains(name))
-            return "Table: " + name + " already exists";
+        std::vector<ColumnIndex::Entry> entries(rows.size());
+        dispatch(type, [&](auto t) {
+            constexpr auto m = decltype(t)::member;
+            if constexpr (decltype(t)::fixedWidth)
+                workers.parallelFor(rows.size(), [&](std::uint64_t begin, std::uint64_t end) {
+                    for (auto i = begin; i < end; i++)
+                        entries[i] = { orderKeyOf(rows[i].data.*m), i };
+                });
+        });
+        // null rows are left out of the index so lookups never see them
+        if (auto const& info = tables[table].columns[column]; info.nullable)
+            std::erase_if(entries, [&](auto const& e) { return !testBit(info.validity, e.row); });
 
-        tables[name] = TableInfo();
-        createTableFile(name);
+        auto index = std::make_unique<ColumnIndex>();
+        index->build(std::move(entries));
+        tables[table].columns[column].index = std::move(index);
 
         return "";
     }
 
-    std::string createColumn(std::string const& name, AttributeKind const& type) {
-        if (tables[table].columns.contains(name))
-            return "Column: " + name + " already exists on table" + table;
+    // loads the live rows of the selected column with low <= value <= high, in row
+    // order, through the column's index when it has one and a scan otherwise
+    std::string lookup(Attribute const& lowLiteral, Attribute const& highLiteral) {
+        auto type = columnType(table, column);
+        if (lowLiteral.kind == AttributeKind::string || highLiteral.kind == AttributeKind::string)
+            return "Cannot compare column " + column + " with a string";
+        // bounds past the column's range are clamped to it
+        Attribute low, high;
+        if (!roundAttr(lowLiteral, type, true, low) || !roundAttr(highLiteral, type, false, high) || orderKey(high) < orderKey(low))
+            return "";
 
-        tables[table].columns[name] = ColumnInfo(type, 0);
+        auto& deleted = tables[table].deleted;
+        auto index = columnIndex(table, column);
+        if (index == nullptr) {
+            std::vector<Attribute> rows;
+            abortIfFails(loadColumn(table, column, rows));
+            dispatch(type, [&](auto t) {
+                constexpr auto m = decltype(t)::member;
+                forEachLive(tables[table].columns[column], deleted, true, 0, rows.size(), [&](std::uint64_t i) {
+                    auto const& x = rows[i];
+                    if (!(x.data.*m < low.data.*m) && !(high.data.*m < x.data.*m))
+                        data.push_back(x);
+                });
+            });
+            return "";
+        }
+
+        std::vector<ColumnIndex::Entry> hits;
+        index->range(orderKey(low), orderKey(high), hits);
+        std::sort(hits.begin(), hits.end(), [](auto const& l, auto const& r) { return l.row < r.row; });
+        // the key encodes the value so the column file is never touched
+        for (auto&& h : hits) {
+            if (deleted.contains(h.row))
+                continue;
+            Attribute x;
+            x.kind = type;
+            fromOrderKey(h.key, x);
+            data.push_back(x);
+        }
 
-        createColumnFile(table, name);
-        
         return "";
     }
 
-    std::string selectTable(std::string const& name) {
-        if (!tables.contains(name))
-            return "Cannot select an non existent table named: " + name;
-        
-        table = name;
+    // builds a sketch of the selected column's live values, appends, imports and
+    // updates keep it current from then on so distinct and quantile never scan
+    std::string createSketch() {
+        auto sketch = std::make_unique<ColumnSketch>();
+        abortIfFails(scanSketch(*sketch, true, true));
+        sketch->dirty = true;
+        tables[table].columns[column].sketch = std::move(sketch);
 
         return "";
     }
 
-    std::string selectColumn(std::string const& name) {
-        if (!tables[table].columns.contains(name))
-            return "Cannot select an non existent column named: " + name + " on table " + table;
-        
-        column = name;
+    // loads the approximate number of distinct live values of the selected column
+    // as a u64, read off its sketch when it has one and by a scan otherwise
+    std::string distinct() {
+        ColumnSketch scanned;
+        auto sketch = tables[table].columns[column].sketch.get();
+        if (sketch == nullptr) {
+            abortIfFails(scanSketch(scanned, true, false));
+            sketch = &scanned;
+        }
+
+        Attribute x;
+        x.kind = AttributeKind::u64;
+        x.data.u64 = sketch->distinct.estimate();
+        data.push_back(x);
 
         return "";
-    }  
+    }
 
-    std::string readColumn() {
-        auto f = fopen(columnFileName(table, column).c_str(), "rb");
-        auto c = columnCount(table, column);
-        auto t = columnType(table, column);
-        readAttributes(f, data, c, t);
+    // loads the approximate value at each quantile q of the selected column's live
+    // values, read off its sketch when it has one and by a scan otherwise
+    std::string quantile(std::vector<double> const& qs) {
+        auto type = columnType(table, column);
+        for (auto q : qs)
+            if (!(q >= 0 && q <= 1))
+                return "Cannot take quantile " + std::to_string(q) + ", it is not between 0 and 1";
 
-        fclose(f);
+        ColumnSketch scanned;
+        auto sketch = tables[table].columns[column].sketch.get();
+        if (sketch == nullptr) {
+            abortIfFails(scanSketch(scanned, false, true));
+            sketch = &scanned;
+        }
+        if (sketch->quantiles.count == 0)
+            return "Cannot take a quantile of column " + column + ", it holds no values";
+
+        for (auto q : qs) {
+            Attribute x;
+            x.kind = type;
+            fromOrderKey(sketch->quantiles.quantile(q), x);
+            data.push_back(x);
+        }
 
         return "";
     }
 
-    std::string appendColumn(Attribute const& attr) {
-        auto f = appendColumnFile(table, column);
-        auto s = attributeSize(attr.kind);
-        switch (attr.kind) {
-        case AttributeKind::i8:  f.write(reinterpret_cast<char const*>(&attr.data.i8), s); break;
-        case AttributeKind::i16: f.write(reinterpret_cast<char const*>(&attr.data.i16), s); break;
-        case AttributeKind::i32: f.write(reinterpret_cast<char const*>(&attr.data.i32), s); break;
-        case AttributeKind::i64: f.write(reinterpret_cast<char const*>(&attr.data.i64), s); break;
-        case AttributeKind::u8:  f.write(reinterpret_cast<char const*>(&attr.data.u8), s); break;
-        case AttributeKind::u16: f.write(reinterpret_cast<char const*>(&attr.data.u16), s); break;
-        case AttributeKind::u32: f.write(reinterpret_cast<char const*>(&attr.data.u32), s); break;
-        case AttributeKind::u64: f.write(reinterpret_cast<char const*>(&attr.data.u64), s); break;
-        case AttributeKind::boolean: f.write(reinterpret_cast<char const*>(&attr.data.boolean), s); break;
-        case AttributeKind::float_: f.write(reinterpret_cast<char const*>(&attr.data.float_), s); break;
-        case AttributeKind::double_: f.write(reinterpret_cast<char const*>(&attr.data.double_), s); break;
-        case AttributeKind::string: return "Todo append string column";
-        case AttributeKind::reference: f.write(reinterpret_cast<char const*>(&attr.data.reference), s); break;
-        }
+    // loads a random sample of n live values of the selected column, single rows
+    // or whole runs of rows when block is set
+    std::string sample(std::uint64_t n, bool block) {
+        return block ? sampleBlocks(n) : sampleRows(n);
+    }
 
-        addColumnCount(table, column, 1);
+    // registers a count, sum, min and max of the selected column, per value of
+    // the key column when one is given, kept up to date by every append
+    std::string createAggregate(std::string const& key) {
+        auto& info = tables[table];
+        if (!key.empty() && !info.columns.contains(key))
+            return "Cannot group by non existent column " + key + " on table " + table;
+        if (findAggregate(column, key))
+            return "Aggregate of column " + column + (key.empty() ? "" : " by " + key) + " already exists";
+
+        Aggregate agg;
+        agg.value = column;
+        agg.key = key;
+        agg.sumKind = sumKindOf(info.columns[column].type);
+        abortIfFails(rebuildAggregate(agg));
+        info.aggregates.push_back(std::move(agg));
+
+        return "";
+    }
+
+    // loads one total of the selected column's aggregate, one value per group in
+    // key order when grouped, keys loads the group keys themselves
+    std::string aggregate(AggregateFn fn, std::string const& key) {
+        auto agg = findAggregate(column, key);
+        if (agg == nullptr)
+            return "Column " + column + " has no aggregate" + (key.empty() ? "" : " by " + key);
+        if (fn == AggregateFn::keys && key.empty())
+            return "Cannot load the keys of aggregate of column " + column + ", it is not grouped";
+        if (agg->stale)
+            abortIfFails(rebuildAggregate(*agg));
+
+        auto load = [&](Aggregate::Totals const& t, std::uint64_t group) {
+            Attribute x;
+            switch (fn) {
+            case AggregateFn::count:
+                x.data.u64 = t.count;
+                break;
+            case AggregateFn::sum:
+                x = t.sum;
+                break;
+            case AggregateFn::min:
+            case AggregateFn::max:
+                x.kind = columnType(table, column);
+                fromOrderKey(fn == AggregateFn::min ? t.min : t.max, x);
+                break;
+            case AggregateFn::keys:
+                x.kind = columnType(table, key);
+                fromOrderKey(group, x);
+                break;
+            }
+            data.push_back(x);
+        };
+
+        if (!key.empty())
+            for (auto&& [group, t] : agg->groups)
+                load(t, group);
+        else if (agg->groups.contains(0))
+            load(agg->groups[0], 0);
+        // an empty column has no smallest or largest value
+        else if (fn == AggregateFn::count || fn == AggregateFn::sum) {
+            Aggregate::Totals none;
+            none.sum.kind = agg->sumKind;
+            none.sum.data.u64 = 0;
+            load(none, 0);
+        }
 
         return "";
     }
 
+    // sends the selected column straight from its file sorted, without loading it
+    // into the data register, in at most about sortBytes of memory
+    std::string sendSorted() {
+        auto type = columnType(table, column);
+        return dispatch(type, [&](auto t) {
+            if constexpr (decltype(t)::fixedWidth)
+                return sendSortedAs<decltype(t)>();
+            else
+                return std::string();
+        });
+    }
+
     // copies the data from data to payload
     // assumes that there is only one column loaded
     std::string send() {
-        auto count = columnCount(table, column);
-        auto type = columnType(table, column);
-        serialize(column, payload);
-        serialize(type, payload);
-        serialize(count, payload);
-        switch (type) {
-        case AttributeKind::i8:        if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.i8, payload); }        else { for (auto&& x : data) serialize(x.data.i8, payload); } break;
-        case AttributeKind::i16:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.i16, payload); }       else { for (auto&& x : data) serialize(x.data.i16, payload); } break;
-        case AttributeKind::i32:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.i32, payload); }       else { for (auto&& x : data) serialize(x.data.i32, payload); } break;
-        case AttributeKind::i64:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.i64, payload); }       else { for (auto&& x : data) serialize(x.data.i64, payload); } break;
-        case AttributeKind::u8:        if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.u8, payload); }        else { for (auto&& x : data) serialize(x.data.u8, payload); } break;
-        case AttributeKind::u16:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.u16, payload); }       else { for (auto&& x : data) serialize(x.data.u16, payload); } break;
-        case AttributeKind::u32:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.u32, payload); }       else { for (auto&& x : data) serialize(x.data.u32, payload); } break;
-        case AttributeKind::u64:       if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.u64, payload); }       else { for (auto&& x : data) serialize(x.data.u64, payload); } break;
-        case AttributeKind::boolean:   if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.boolean, payload); }   else { for (auto&& x : data) serialize(x.data.boolean, payload); } break;
-        case AttributeKind::float_:    if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.float_, payload); }    else { for (auto&& x : data) serialize(x.data.float_, payload); } break;
-        case AttributeKind::double_:   if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.double_, payload); }   else { for (auto&& x : data) serialize(x.data.double_, payload); } break;
-        case AttributeKind::string:    if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.string, payload); }    else { for (auto&& x : data) serialize(x.data.string, payload); } break;
-        case AttributeKind::reference: if (!ordering.empty()) { for (std::uint64_t idx : ordering) serialize(data[idx].data.reference, payload); } else { for (auto&& x : data) serialize(x.data.reference, payload); } break;
-        }
+        std::uint64_t count = ordering.empty() ? data.size() : ordering.size();
+        auto type = dataType();
+        auto words = validity.empty() ? std::vector<std::uint64_t>() : sentValidity(count);
+        sendColumn(type, count, validity.empty() ? nullptr : &words, [&] {
+            dispatch(type, [&](auto t) { sendValues<decltype(t)>(); });
+        });
 
         return "";
     }
 
     std::string open(PayloadKind k) {
+        // the columnar layout is flat, every column record names its table
+        if (format == OutputFormat::columnar)
+            return "";
         switch (k)
         {
         case PayloadKind::payload: payload.push_back(static_cast<byte>(ControlMessage::startPayload)); break;
@@ -632,6 +3556,8 @@ public:
     }
 
     std::string close(PayloadKind k) {
+        if (format == OutputFormat::columnar)
+            return "";
         switch (k)
         {
         case PayloadKind::payload: payload.push_back(static_cast<byte>(ControlMessage::endPayload)); break;
@@ -646,55 +3572,119 @@ public:
     std::string sort() {
         ordering.clear();
 
-        auto type = columnType(table, column);
-        auto count = columnCount(table, column);
+        auto type = dataType();
+        auto count = data.size();
         ordering.reserve(count);
 
-        for (std::uint64_t i = 0; i < count; i++)
-            ordering.push_back(i);
-
-        switch (type) {
-        case AttributeKind::i8:        std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.i8 < data[r].data.i8; }); break;
-        case AttributeKind::i16:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.i16 < data[r].data.i16; }); break;
-        case AttributeKind::i32:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.i32 < data[r].data.i32; }); break;
-        case AttributeKind::i64:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.i64 < data[r].data.i64; }); break;
-        case AttributeKind::u8:        std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.u8 < data[r].data.u8; }); break;
-        case AttributeKind::u16:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.u16 < data[r].data.u16; }); break;
-        case AttributeKind::u32:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.u32 < data[r].data.u32; }); break;
-        case AttributeKind::u64:       std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.u64 < data[r].data.u64; }); break;
-        case AttributeKind::boolean:   std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.boolean < data[r].data.boolean; }); break;
-        case AttributeKind::float_:    std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.float_ < data[r].data.float_; }); break;
-        case AttributeKind::double_:   std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.double_ < data[r].data.double_; }); break;
-        case AttributeKind::string:    std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.string < data[r].data.string; }); break;
-        case AttributeKind::reference: std::sort(ordering.begin(), ordering.end(), [&](std::uint64_t l, std::uint64_t r){ return data[l].data.reference < data[r].data.reference; }); break;
+        if (validity.empty())
+            for (std::uint64_t i = 0; i < count; i++)
+                ordering.push_back(i);
+        else {
+            // nulls go last, gathered a word at a time behind the rows with values
+            for (int valid = 1; valid >= 0; valid--)
+                for (std::uint64_t w = 0; w < count; w += 64) {
+                    auto bits = valid ? validity[w >> 6] : ~validity[w >> 6];
+                    if (count - w < 64)
+                        bits &= (std::uint64_t(1) << (count - w)) - 1;
+                    for (; bits != 0; bits &= bits - 1)
+                        ordering.push_back(w + std::countr_zero(bits));
+                }
         }
+        auto values = validity.empty() ? count : std::accumulate(validity.begin(), validity.end(), std::uint64_t(0), [](std::uint64_t n, std::uint64_t w) { return n + std::popcount(w); });
+
+        dispatch(type, [&](auto t) { sortBy<decltype(t)>(values); });
         return "";
     }
 
     std::string free() {
         data.resize(0);
+        ordering.clear();
+        validity.clear();
         return "";
     }
 
     std::string execute(std::vector<Instruction> const& instructions) {
         clearState();
+        if (format == OutputFormat::columnar) {
+            columnsSent = 0;
+            std::copy(columnarMagic, columnarMagic + 8, std::back_inserter(payload));
+            serialize(columnarVersion, payload);
+            serialize(std::uint32_t(0), payload);
+            serialize(std::uint64_t(0), payload); // column count
+            padPayload();
+        }
+
+        std::string error;
+        try {
+            error = run(instructions);
+        }
+        catch (std::exception const& e) {
+            error = e.what();
+        }
+        prefetcher.wait();
+        releasePrefetched();
+        saveTables();
+        if (verbose)
+            std::cout << "Block cache: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.evictions << " evictions, " << prefetched << " prefetched, " << cache.bytesUsed() << " bytes" << std::endl;
+        if (error.empty() && format == OutputFormat::columnar)
+            patch(16, columnsSent);
+        if (dump == nullptr) {
+            if (!error.empty())
+                return error;
+            std::ofstream f(dumpFile, std::ios::binary);
+            f.write(reinterpret_cast<char const*>(payload.data()), payload.size());
+            return "";
+        }
+
+        // part of the payload was streamed, the rest follows it
+        if (error.empty())
+            error = flushPayload();
+        fclose(dump);
+        dump = nullptr;
+        std::error_code ec;
+        if (error.empty()) {
+            std::filesystem::rename(dumpPartFileName(), dumpFile, ec);
+            if (ec)
+                error = "Cannot write output file " + dumpFile;
+        }
+        if (!error.empty())
+            std::filesystem::remove(dumpPartFileName(), ec);
+        return error;
+    }
 
+private:
+    std::string run(std::vector<Instruction> const& instructions) {
         std::uint64_t ic = 0;
         std::uint64_t n = instructions.size();
 
+        queued.clear();
+
         while (ic < n) {
             auto& ins = instructions[ic];
+            if (writesColumns(ins.kind)) {
+                prefetcher.wait();
+                releasePrefetched();
+            }
+            // a read loads its own column, the window of columns loaded ahead
+            // moves on past it
+            std::string read;
+            if (ins.kind == InstructionKind::readColumn) {
+                read = table + "/" + column;
+                queued.insert(read);
+                planPrefetch(instructions, ic);
+            }
             if (verbose) {
                 std::cout << "Executing: ";
                 print(ins);
             }
+            abortIfFails(checkSelection(ins));
             switch (ins.kind) {
             case InstructionKind::createTable:
                 abortIfFails(createTable(ins.data.createTable.name));
                 ic++;
                 break;
             case InstructionKind::createColumn:
-                abortIfFails(createColumn(ins.data.createColumn.name, ins.data.createColumn.type));
+                abortIfFails(createColumn(ins.data.createColumn.name, ins.data.createColumn.type, ins.data.createColumn.nullable));
                 ic++;
                 break;
             case InstructionKind::selectTable:               
@@ -713,6 +3703,10 @@ public:
                 abortIfFails(appendColumn(ins.data.appendColumn.attr));
                 ic++;
                 break;
+            case InstructionKind::appendNull:
+                abortIfFails(appendNull());
+                ic++;
+                break;
             case InstructionKind::end:
                 goto end;
             case InstructionKind::send:
@@ -735,34 +3729,90 @@ public:
                 abortIfFails(free());
                 ic++;
                 break;
+            case InstructionKind::deleteRow:
+                abortIfFails(deleteRow(ins.data.deleteRow.row));
+                ic++;
+                break;
+            case InstructionKind::deleteWhere:
+                abortIfFails(deleteWhere(ins.data.deleteWhere.op, ins.data.deleteWhere.value));
+                ic++;
+                break;
+            case InstructionKind::updateRow:
+                abortIfFails(updateRow(ins.data.updateRow.row, ins.data.updateRow.value));
+                ic++;
+                break;
+            case InstructionKind::createIndex:
+                abortIfFails(createIndex());
+                ic++;
+                break;
+            case InstructionKind::importTable:
+                abortIfFails(importTable(ins.data.importTable.format, ins.data.importTable.file));
+                ic++;
+                break;
+            case InstructionKind::lookup: {
+                auto n = data.size();
+                abortIfFails(lookup(ins.data.lookup.low, ins.data.lookup.high));
+                // lookups never load nulls
+                loadedValues(n);
+                ic++;
+                break;
+            }
+            case InstructionKind::createSketch:
+                abortIfFails(createSketch());
+                ic++;
+                break;
+            case InstructionKind::distinct: {
+                auto n = data.size();
+                abortIfFails(distinct());
+                loadedValues(n);
+                ic++;
+                break;
             }
+            case InstructionKind::quantile: {
+                auto n = data.size();
+                abortIfFails(quantile(ins.data.quantile.q));
+                loadedValues(n);
+                ic++;
+                break;
+            }
+            case InstructionKind::sample: {
+                auto n = data.size();
+                abortIfFails(sample(ins.data.sample.n, ins.data.sample.block));
+                // samples never load nulls
+                loadedValues(n);
+                ic++;
+                break;
+            }
+            case InstructionKind::sendSorted:
+                abortIfFails(sendSorted());
+                ic++;
+                break;
+            case InstructionKind::createAggregate:
+                abortIfFails(createAggregate(ins.data.createAggregate.key));
+                ic++;
+                break;
+            case InstructionKind::aggregate: {
+                auto n = data.size();
+                abortIfFails(aggregate(ins.data.aggregate.fn, ins.data.aggregate.key));
+                loadedValues(n);
+                ic++;
+                break;
+            }
+            }
+
+            if (!read.empty())
+                releasePrefetched(read);
+            // the columns after a write are read from the files it changed
+            if (writesColumns(ins.kind))
+                queued.clear();
         }
 
     end:
-        std::ofstream f(dumpFile);
-        for (auto&& b : payload)
-            f << b;
         return "";
     }
 
 };
 
-std::vector<std::string> split(std::string const& s, char c) {
-    std::vector<std::string> words;
-    std::string buff;
-    for (auto&& x : s)
-        if (x == c && buff != "") {
-            words.push_back(buff);
-            buff.clear();
-        }
-        else {
-            buff += x;
-        }
-    if (!buff.empty())
-        words.push_back(buff);
-    return words;
-}
-
 AttributeKind parseType(std::string const& word) {
     if (word == "i8") return AttributeKind::i8;
     else if (word == "i16") return AttributeKind::i16;
@@ -780,6 +3830,7 @@ AttributeKind parseType(std::string const& word) {
 }
 
 void parseAttr(std::string const& word, Attribute& attr) {
+    std::size_t used = 0;
     if (word == "true") {
         attr.data.boolean = true;
         attr.kind = AttributeKind::boolean;
@@ -789,17 +3840,42 @@ void parseAttr(std::string const& word, Attribute& attr) {
         attr.kind = AttributeKind::boolean;
     }
     else if (word.size() > 1 && word[0] == '"' && word[word.size() - 1] == '"') {
-        attr.data.string = word.substr(1, word.size() - 2);
+        std::construct_at(&attr.data.string, word.substr(1, word.size() - 2));
         attr.kind = AttributeKind::string;
     }
     else if (auto i = word.find_first_of('.'); i != static_cast<std::size_t>(-1) && i == word.find_last_of('.')) {
-        attr.data.double_ = std::stod(word);
+        attr.data.double_ = std::stod(word, &used);
         attr.kind = AttributeKind::double_;
     }
+    else if (word[0] == '-') {
+        attr.data.i64 = std::stoll(word, &used);
+        attr.kind = AttributeKind::i64;
+    }
     else {
-        attr.data.u64 = std::stol(word);
+        attr.data.u64 = std::stoull(word, &used);
         attr.kind = AttributeKind::u64;
     }
+    if (attr.kind != AttributeKind::boolean && attr.kind != AttributeKind::string && used != word.size())
+        throw std::runtime_error("Cannot parse value " + word);
+}
+
+CompareOp parseCompareOp(std::string const& word) {
+    if (word == "=") return CompareOp::eq;
+    else if (word == "!=") return CompareOp::ne;
+    else if (word == "<") return CompareOp::lt;
+    else if (word == "<=") return CompareOp::le;
+    else if (word == ">") return CompareOp::gt;
+    else if (word == ">=") return CompareOp::ge;
+    else throw std::runtime_error("Imma reading bullshit here");
+}
+
+std::optional<AggregateFn> parseAggregateFn(std::string const& word) {
+    if (word == "count") return AggregateFn::count;
+    else if (word == "sum") return AggregateFn::sum;
+    else if (word == "min") return AggregateFn::min;
+    else if (word == "max") return AggregateFn::max;
+    else if (word == "keys") return AggregateFn::keys;
+    else return std::nullopt;
 }
 
 PayloadKind parsePayloadKind(std::string const& word) {
@@ -812,117 +3888,246 @@ PayloadKind parsePayloadKind(std::string const& word) {
 
 std::vector<Instruction> loadInstructions(std::string const& filename) {
     std::ifstream file(filename);
+    if (!file)
+        throw std::runtime_error("Cannot open program " + filename);
 
     std::vector<Instruction> instructions;
 
     std::string line;
+    std::uint64_t number = 0;
 
-    while (std::getline(file, line)) {
-        auto words = split(line, ' ');
-        auto n = words.size();
-        if (n > 0) {
-            if (words[0].starts_with("//"))
-                continue;
-            else if (words[0] == "select") {
-                if (n == 3) {
-                    if (words[1] == "table") {
+    try {
+        while (std::getline(file, line)) {
+            number++;
+            auto words = split(line, ' ');
+            auto n = words.size();
+            if (n > 0) {
+                if (words[0].starts_with("//"))
+                    continue;
+                else if (words[0] == "select") {
+                    if (n == 3) {
+                        if (words[1] == "table") {
+                            Instruction ins;
+                            ins.kind = InstructionKind::selectTable;
+                            std::construct_at(&ins.data.selectTable, words[2]);
+                            instructions.push_back(ins);
+                            continue;
+                        }
+                        else if (words[1] == "column") {
+                            Instruction ins;
+                            ins.kind = InstructionKind::selectColumn;
+                            std::construct_at(&ins.data.selectColumn, words[2]);
+                            instructions.push_back(ins);
+                            continue;
+                        }
+                    }
+                }  
+                else if (words[0] == "create" && n >= 2) {
+                    if (n == 2 && words[1] == "index") {
+                        Instruction ins;
+                        ins.kind = InstructionKind::createIndex;
+                        ins.data.createIndex = {};
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                    else if (n == 2 && words[1] == "sketch") {
+                        Instruction ins;
+                        ins.kind = InstructionKind::createSketch;
+                        ins.data.createSketch = {};
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                    else if (words[1] == "aggregate" && (n == 2 || (n == 4 && words[2] == "by"))) {
                         Instruction ins;
-                        ins.kind = InstructionKind::selectTable;
-                        ins.data.selectTable.name = words[2];
+                        ins.kind = InstructionKind::createAggregate;
+                        std::construct_at(&ins.data.createAggregate, n == 4 ? words[3] : "");
                         instructions.push_back(ins);
                         continue;
                     }
+                    else if (words[1] == "table") {
+                        if (n == 3) {
+                            Instruction ins;
+                            ins.kind = InstructionKind::createTable;
+                            std::construct_at(&ins.data.createTable, words[2]);
+                            instructions.push_back(ins);                        
+                            continue;
+                        }
+                    }
                     else if (words[1] == "column") {
+                        if (n == 4 || (n == 5 && words[4] == "nullable")) {
+                            Instruction ins;
+                            ins.kind = InstructionKind::createColumn;
+                            std::construct_at(&ins.data.createColumn, words[2], parseType(words[3]), n == 5);
+                            instructions.push_back(ins);
+                            continue;
+                        }
+                    }
+                }
+                else if (words[0] == "read") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::readColumn;
+                    ins.data.readColumn = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "append") {
+                    if (n == 2 && words[1] == "null") {
                         Instruction ins;
-                        ins.kind = InstructionKind::selectColumn;
-                        ins.data.selectColumn.name = words[2];
+                        ins.kind = InstructionKind::appendNull;
+                        ins.data.appendNull = {};
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                    else if (n == 2) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::appendColumn;
+                        parseAttr(words[1], ins.data.appendColumn.attr);
                         instructions.push_back(ins);
                         continue;
                     }
                 }
-            }  
-            else if (words[0] == "create") {
-                if (words[1] == "table") {
-                    if (n == 3) {
+                else if (words[0] == "end") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::end;
+                    ins.data.end = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "send" && n == 2 && words[1] == "sorted") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::sendSorted;
+                    ins.data.sendSorted = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "send") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::send;
+                    ins.data.send = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "open" && n == 2) {
+                    Instruction ins;
+                    ins.kind = InstructionKind::open;
+                    ins.data.open.kind = parsePayloadKind(words[1]);
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "close" && n == 2) {
+                    Instruction ins;
+                    ins.kind = InstructionKind::close;
+                    ins.data.close.kind = parsePayloadKind(words[1]);
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "sort") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::sort;
+                    ins.data.sort = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "free") {
+                    Instruction ins;
+                    ins.kind = InstructionKind::free;
+                    ins.data.free = {};
+                    instructions.push_back(ins);
+                    continue;
+                }
+                else if (words[0] == "delete") {
+                    if (n == 2) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::deleteRow;
+                        ins.data.deleteRow.row = std::stoull(words[1]);
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                    else if (n == 4 && words[1] == "where") {
                         Instruction ins;
-                        ins.kind = InstructionKind::createTable;
-                        ins.data.createTable.name = words[2];
-                        instructions.push_back(ins);                        
+                        ins.kind = InstructionKind::deleteWhere;
+                        ins.data.deleteWhere.op = parseCompareOp(words[2]);
+                        std::construct_at(&ins.data.deleteWhere.value);
+                        parseAttr(words[3], ins.data.deleteWhere.value);
+                        instructions.push_back(ins);
                         continue;
                     }
                 }
-                else if (words[1] == "column") {
-                    if (n == 4) {
+                else if (words[0] == "import") {
+                    if (n == 3 && (words[1] == "csv" || words[1] == "binary")) {
                         Instruction ins;
-                        ins.kind = InstructionKind::createColumn;
-                        ins.data.createColumn.name = words[2];
-                        ins.data.createColumn.type=parseType(words[3]);
+                        ins.kind = InstructionKind::importTable;
+                        std::construct_at(&ins.data.importTable, words[1] == "csv" ? ImportFormat::csv : ImportFormat::binary, words[2]);
                         instructions.push_back(ins);
                         continue;
                     }
                 }
-            }
-            else if (words[0] == "read") {
-                Instruction ins;
-                ins.kind = InstructionKind::readColumn;
-                ins.data.readColumn = {};
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "append") {
-                if (n == 2) {
+                else if (words[0] == "lookup") {
+                    if (n == 2 || n == 3) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::lookup;
+                        std::construct_at(&ins.data.lookup);
+                        parseAttr(words[1], ins.data.lookup.low);
+                        parseAttr(words[n - 1], ins.data.lookup.high);
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                }
+                else if (words[0] == "aggregate") {
+                    if ((n == 2 || (n == 4 && words[2] == "by")) && parseAggregateFn(words[1])) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::aggregate;
+                        std::construct_at(&ins.data.aggregate, *parseAggregateFn(words[1]), n == 4 ? words[3] : "");
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                }
+                else if (words[0] == "distinct") {
                     Instruction ins;
-                    ins.kind = InstructionKind::appendColumn;
-                    parseAttr(words[1], ins.data.appendColumn.attr);
+                    ins.kind = InstructionKind::distinct;
+                    ins.data.distinct = {};
                     instructions.push_back(ins);
                     continue;
                 }
+                else if (words[0] == "quantile") {
+                    if (n >= 2) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::quantile;
+                        std::construct_at(&ins.data.quantile);
+                        for (std::size_t i = 1; i < n; i++)
+                            ins.data.quantile.q.push_back(std::stod(words[i]));
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                }
+                else if (words[0] == "sample") {
+                    if (n == 2 || (n == 3 && words[1] == "block")) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::sample;
+                        ins.data.sample.n = std::stoull(words[n - 1]);
+                        ins.data.sample.block = n == 3;
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                }
+                else if (words[0] == "update") {
+                    if (n == 3) {
+                        Instruction ins;
+                        ins.kind = InstructionKind::updateRow;
+                        ins.data.updateRow.row = std::stoull(words[1]);
+                        std::construct_at(&ins.data.updateRow.value);
+                        parseAttr(words[2], ins.data.updateRow.value);
+                        instructions.push_back(ins);
+                        continue;
+                    }
+                }
+                throw std::runtime_error("Imma reading bullshit here");
             }
-            else if (words[0] == "end") {
-                Instruction ins;
-                ins.kind = InstructionKind::end;
-                ins.data.end = {};
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "send") {
-                Instruction ins;
-                ins.kind = InstructionKind::send;
-                ins.data.send = {};
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "open" && n == 2) {
-                Instruction ins;
-                ins.kind = InstructionKind::open;
-                ins.data.open.kind = parsePayloadKind(words[1]);
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "close" && n == 2) {
-                Instruction ins;
-                ins.kind = InstructionKind::close;
-                ins.data.close.kind = parsePayloadKind(words[1]);
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "sort") {
-                Instruction ins;
-                ins.kind = InstructionKind::sort;
-                ins.data.sort = {};
-                instructions.push_back(ins);
-                continue;
-            }
-            else if (words[0] == "free") {
-                Instruction ins;
-                ins.kind = InstructionKind::free;
-                ins.data.free = {};
-                instructions.push_back(ins);
-                continue;
-            }
-            throw std::runtime_error("Imma reading bullshit here");
         }
     }
+    catch (std::exception const& e) {
+        throw std::runtime_error("Cannot parse line " + std::to_string(number) + " '" + line + "': " + e.what());
+    }
 
     return instructions;
 }
@@ -933,16 +4138,45 @@ int main(int argc, char** argv) {
     if (argc < 2) return 1;
     
     std::string filename = argv[1];
+    std::uint64_t cacheMb = 1024;
+    std::uint64_t sortMb = 1024;
+    auto format = OutputFormat::frames;
   
-    if (argc == 3) { //} && strcmp(argv[2], "--verbose") == 1) {
-        verbose = true;
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--cache-mb" || arg == "--sort-mb") {
+            std::uint64_t mb = 0;
+            std::string_view value = i + 1 < argc ? argv[i + 1] : "";
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), mb);
+            if (value.empty() || ec != std::errc() || end != value.data() + value.size()) {
+                std::cerr << "ERROR: " << arg << " needs a number of megabytes" << std::endl;
+                return 1;
+            }
+            (arg == "--cache-mb" ? cacheMb : sortMb) = mb;
+            i++;
+        }
+        else if (arg == "--columnar")
+            format = OutputFormat::columnar;
+        else if (arg == "--verbose")
+            verbose = true;
+        else {
+            std::cerr << "ERROR: unknown option " << arg << std::endl;
+            return 1;
+        }
     }
 
     std::cout << "Loading file: " << filename << std::endl;
 
-    DataBase db("out.hex");
+    DataBase db("out.hex", cacheMb << 20, format, sortMb << 20);
 
-    auto instructions = loadInstructions(filename);
+    std::vector<Instruction> instructions;
+    try {
+        instructions = loadInstructions(filename);
+    }
+    catch (std::exception const& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
 
     std::cout << "Loaded Instructions (" << instructions.size() << ")" << std::endl;
 
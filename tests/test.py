@@ -0,0 +1,516 @@
+"""Differential and throughput tests for nitro-db.
+
+Random programs are run through the binary one after another in a scratch
+directory and every column they send is compared with what a plain in-memory
+model of the tables (values, nulls and tombstones) says it should be, exactly
+or, for the sketch backed distinct and quantile and for random samples, within
+their error bounds; then ingest, sort and send run on fixed synthetic data
+against throughput floors.
+
+    python3 tests/test.py <nitro-db> [--seed n] [--cases n] [--rows n] [--skip-perf]
+"""
+
+import argparse
+import array
+import bisect
+import collections
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+# the frame and columnar decoders of client.py, without leaving a cache behind
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import client
+
+# smallest value, largest value and struct code of each integer type
+INTEGERS = {
+    'i8': (-2**7, 2**7 - 1, 'b'),
+    'i16': (-2**15, 2**15 - 1, 'h'),
+    'i32': (-2**31, 2**31 - 1, 'i'),
+    'i64': (-2**63, 2**63 - 1, 'q'),
+    'u8': (0, 2**8 - 1, 'B'),
+    'u16': (0, 2**16 - 1, 'H'),
+    'u32': (0, 2**32 - 1, 'I'),
+    'u64': (0, 2**64 - 1, 'Q'),
+}
+
+# struct code of every column type
+TYPES = {name: code for name, (_, _, code) in INTEGERS.items()} | {'float': 'f', 'double': 'd', 'bool': '?'}
+
+COMPARES = {
+    '=': lambda x, v: x == v,
+    '!=': lambda x, v: x != v,
+    '<': lambda x, v: x < v,
+    '<=': lambda x, v: x <= v,
+    '>': lambda x, v: x > v,
+    '>=': lambda x, v: x >= v,
+}
+
+FLAGS = [[], ['--columnar'], ['--sort-mb', '0'], ['--cache-mb', '0'], ['--columnar', '--sort-mb', '0']]
+
+
+def literal(x):
+    """x as the program text of a value, floats are quarters so two decimals are exact"""
+    if isinstance(x, bool):
+        return 'true' if x else 'false'
+    if isinstance(x, float):
+        return f'{x:.2f}'
+    return str(x)
+
+
+def signed(x, type):
+    """frames carry every integer unsigned, the model keeps them signed"""
+    if x is None or not type.startswith('i'):
+        return x
+    bits = {'i8': 8, 'i16': 16, 'i32': 32, 'i64': 64}[type]
+    return x - (1 << bits) if x >= 1 << (bits - 1) else x
+
+
+def sentColumns(filename):
+    """elements of every column out.hex holds, in send order"""
+    result = client.readResult(filename, {})
+    if 'columns' in result:
+        return [[signed(x, c['type']) for x in c['elements']] for c in result['columns']]
+    return [[signed(x, a['type']) for x in a['elements']]
+            for p in result['data'] for t in p['tables'] for a in t['attributes']]
+
+
+# error bounds of the sketches behind distinct and quantile: the estimate of a
+# 2^14 register HyperLogLog and the rank of a value out of a k = 256 KLL sketch,
+# both several standard errors wide so a correct sketch should not trip them
+DISTINCT_ERROR = 0.04
+RANK_ERROR = 0.03
+
+
+def distinctCheck(values):
+    n = len(set(values))
+    return lambda got: len(got) == 1 and abs(got[0] - n) <= 1 + DISTINCT_ERROR * n
+
+
+def quantileCheck(values, qs):
+    """each value sent is one of values and ranks within RANK_ERROR of its q"""
+    xs = sorted(values)
+    n = len(xs)
+    slack = 1 + RANK_ERROR * n
+
+    def check(got):
+        if len(got) != len(qs):
+            return False
+        for q, v in zip(qs, got):
+            target = min(int(q * n), n - 1)
+            below, upto = bisect.bisect_left(xs, v), bisect.bisect_right(xs, v)
+            if below == upto or below > target + slack or upto <= target - slack:
+                return False
+        return True
+    return check
+
+
+def sampleCheck(values, n, ordered):
+    """min(n, len(values)) of values, in row order for a row sample"""
+    def check(got):
+        if len(got) != min(n, len(values)):
+            return False
+        if ordered:
+            rest = iter(values)
+            return all(any(x == y for y in rest) for x in got)
+        return not collections.Counter(got) - collections.Counter(values)
+    return check
+
+
+def matches(got, expected):
+    """columns sent against the model's, a callable checks a column it cannot predict exactly"""
+    if isinstance(got, str) or len(got) != len(expected):
+        return False
+    return all(e(g) if callable(e) else g == e for g, e in zip(got, expected))
+
+
+class Column:
+    def __init__(self, type, nullable):
+        self.type = type
+        self.nullable = nullable
+        self.values = []
+        # every value the column's sketch has taken, None without a sketch
+        self.sketched = None
+
+    def add(self, xs):
+        self.values += xs
+        if self.sketched is not None:
+            self.sketched += [x for x in xs if x is not None]
+
+
+class Table:
+    def __init__(self):
+        self.columns = {}
+        self.deleted = set()
+        # (value column, key column or '') of every aggregate
+        self.aggregates = set()
+
+    def rowCount(self):
+        return max((len(c.values) for c in self.columns.values()), default=0)
+
+    def live(self, name):
+        c = self.columns[name]
+        return [x for r, x in enumerate(c.values) if r not in self.deleted]
+
+    def present(self, name):
+        return [x for x in self.live(name) if x is not None]
+
+
+class Model:
+    """generates valid programs and predicts what each one sends"""
+
+    def __init__(self, rng, directory):
+        self.rng = rng
+        self.directory = directory
+        self.tables = {}
+        self.imports = 0
+
+    def value(self, type):
+        if type == 'bool':
+            return self.rng.random() < 0.5
+        if type in ('float', 'double'):
+            # quarters up to 2^20 are exact in a float and in every sum of them
+            if self.rng.random() < 0.8:
+                return self.rng.randint(-160, 480) / 4
+            return self.rng.randint(-2**22, 2**22) / 4
+        lo, hi, _ = INTEGERS[type]
+        if self.rng.random() < 0.8:
+            return self.rng.randint(max(lo, -40), min(hi, 120))
+        return self.rng.choice([lo, hi, self.rng.randint(lo, hi)])
+
+    def bound(self, type):
+        """a literal to compare a column with, now and then between two integers
+        or outside the range of an integer column"""
+        if type not in INTEGERS or self.rng.random() < 0.8:
+            return self.value(type)
+        lo, hi, _ = INTEGERS[type]
+        if self.rng.random() < 0.5:
+            return self.rng.randint(-40, 120) + 0.5
+        return self.rng.choice([x for x in (lo - self.rng.randint(1, 10), hi + self.rng.randint(1, 10)) if -2**63 <= x < 2**64])
+
+    def sortedValues(self, values):
+        return sorted(x for x in values if x is not None) + [None] * values.count(None)
+
+    def aggregate(self, table, value, key, fn):
+        t = self.tables[table]
+        c = t.columns[value]
+        groups = {}
+        for r, x in enumerate(c.values):
+            if r in t.deleted or x is None:
+                continue
+            if key:
+                keys = t.columns[key].values
+                if r >= len(keys) or keys[r] is None:
+                    continue
+                groups.setdefault(keys[r], []).append(x)
+            else:
+                groups.setdefault(0, []).append(x)
+        if not key and not groups and fn in ('count', 'sum'):
+            groups[0] = []
+
+        def total(xs):
+            if fn == 'count':
+                return len(xs)
+            if fn == 'min':
+                return min(xs)
+            if fn == 'max':
+                return max(xs)
+            if c.type in ('float', 'double'):
+                return float(sum(xs))
+            s = sum(xs) % 2**64
+            return s - 2**64 if c.type.startswith('i') and s >= 2**63 else s
+        return [k if fn == 'keys' else total(groups[k]) for k in sorted(groups)]
+
+    def importFile(self, content, binary):
+        self.imports += 1
+        name = os.path.join(self.directory, f'import{self.imports}.' + ('bin' if binary else 'csv'))
+        with open(name, 'wb' if binary else 'w') as f:
+            f.write(content)
+        return name
+
+    def program(self, steps):
+        """one program of about steps instructions and the columns it sends"""
+        rng = self.rng
+        out = []
+        sent = []
+
+        def select(table, column=None):
+            out.append(f'select table {table}')
+            if column is not None:
+                out.append(f'select column {column}')
+
+        def query(kind):
+            choices = [(t, c) for t in self.tables for c in self.tables[t].columns]
+            if not choices:
+                return
+            table, column = rng.choice(choices)
+            t = self.tables[table]
+            c = t.columns[column]
+            select(table, column)
+            out.append('open data')
+            if kind == 'read':
+                out.extend(['read', 'send'])
+                sent.append(t.live(column))
+            elif kind == 'sort':
+                out.extend(['read', 'sort', 'send'])
+                sent.append(self.sortedValues(t.live(column)))
+            elif kind == 'sorted':
+                out.append('send sorted')
+                sent.append(self.sortedValues(t.live(column)))
+            elif kind == 'lookup':
+                lo, hi = sorted([self.bound(c.type), self.bound(c.type)])
+                out.extend([f'lookup {literal(lo)} {literal(hi)}', 'send'])
+                sent.append([x for x in t.live(column) if x is not None and lo <= x <= hi])
+            elif kind == 'distinct':
+                out.extend(['distinct', 'send'])
+                sent.append(distinctCheck(t.present(column) if c.sketched is None else c.sketched))
+            elif kind == 'quantile':
+                values = t.present(column) if c.sketched is None else c.sketched
+                qs = rng.sample([0, 0.1, 0.25, 0.5, 0.75, 0.9, 1], rng.randint(1, 3))
+                if values:
+                    out.extend(['quantile ' + ' '.join(map(str, qs)), 'send'])
+                    sent.append(quantileCheck(values, qs))
+                else:
+                    out.extend(['read', 'send'])
+                    sent.append(t.live(column))
+            elif kind == 'sample':
+                block = rng.random() < 0.3
+                n = rng.choice([rng.randint(1, 20), len(c.values) + 5, rng.randint(1, 5000)])
+                out.extend([f'sample {"block " if block else ""}{n}', 'send'])
+                sent.append(sampleCheck(t.present(column), n, not block))
+            else:
+                keys = [k for v, k in t.aggregates if v == column]
+                if not keys:
+                    key = rng.choice(['', rng.choice(list(t.columns))])
+                    out.append('create aggregate' + (f' by {key}' if key else ''))
+                    t.aggregates.add((column, key))
+                else:
+                    key = rng.choice(keys)
+                fn = rng.choice(['count', 'sum', 'min', 'max'] + (['keys'] if key else []))
+                out.extend([f'aggregate {fn}' + (f' by {key}' if key else ''), 'send'])
+                sent.append(self.aggregate(table, column, key, fn))
+            out.extend(['close data', 'free'])
+
+        def mutate():
+            r = rng.random()
+            if r < 0.05 or not self.tables:
+                name = f't{len(self.tables)}'
+                out.append(f'create table {name}')
+                self.tables[name] = Table()
+                select(name)
+                return
+            table = rng.choice(list(self.tables))
+            t = self.tables[table]
+            if r < 0.15 or not t.columns:
+                if len(t.columns) < 4:
+                    name = f'c{len(t.columns)}'
+                    type = rng.choice(list(TYPES))
+                    nullable = rng.random() < 0.5
+                    select(table)
+                    out.append(f'create column {name} {type}' + (' nullable' if nullable else ''))
+                    t.columns[name] = Column(type, nullable)
+                return
+            column = rng.choice(list(t.columns))
+            c = t.columns[column]
+            if r < 0.45:
+                select(table, column)
+                for _ in range(rng.randint(1, 30)):
+                    if c.nullable and rng.random() < 0.2:
+                        out.append('append null')
+                        c.add([None])
+                    else:
+                        x = self.value(c.type)
+                        out.append(f'append {literal(x)}')
+                        c.add([x])
+            elif r < 0.55:
+                rows = [i for i in range(len(c.values)) if i not in t.deleted]
+                if rows:
+                    row = rng.choice(rows)
+                    x = self.value(c.type)
+                    select(table, column)
+                    out.append(f'update {row} {literal(x)}')
+                    c.values[row] = x
+                    if c.sketched is not None:
+                        c.sketched.append(x)
+            elif r < 0.62:
+                if t.rowCount():
+                    row = rng.randrange(t.rowCount())
+                    select(table)
+                    out.append(f'delete {row}')
+                    t.deleted.add(row)
+            elif r < 0.67:
+                op = rng.choice(list(COMPARES))
+                v = self.bound(c.type)
+                select(table, column)
+                out.append(f'delete where {op} {literal(v)}')
+                t.deleted |= {i for i, x in enumerate(c.values) if x is not None and COMPARES[op](x, v)}
+            elif r < 0.70:
+                select(table, column)
+                out.append('create index')
+            elif r < 0.72:
+                select(table, column)
+                out.append('create sketch')
+                c.sketched = t.present(column)
+            elif r < 0.87:
+                # a big enough import spills send sorted to runs under --sort-mb 0
+                n = rng.choice([rng.randint(1, 50), rng.randint(1000, 9000)])
+                names = [name for name in t.columns if not t.columns[name].nullable or rng.random() < 0.7]
+                if not names:
+                    return
+                rng.shuffle(names)
+                # a lone null field would be an empty line, which csv skips
+                nulls = 0.1 if len(names) > 1 else 0
+                rows = [[None if t.columns[name].nullable and rng.random() < nulls else self.value(t.columns[name].type) for name in names] for _ in range(n)]
+                text = ','.join(names) + '\n' + ''.join(','.join('' if x is None else literal(x) for x in row) + '\n' for row in rows)
+                select(table)
+                out.append(f'import csv {self.importFile(text, False)}')
+                for k, name in enumerate(names):
+                    t.columns[name].add([row[k] for row in rows])
+                for name in t.columns:
+                    if name not in names:
+                        t.columns[name].add([None] * n)
+            else:
+                if any(c.nullable for c in t.columns.values()) and rng.random() < 0.5:
+                    return
+                n = rng.randint(1, 3000)
+                rows = [[self.value(c.type) for c in t.columns.values()] for _ in range(n)]
+                data = b''.join(struct.pack('<' + ''.join(TYPES[c.type] for c in t.columns.values()), *row) for row in rows)
+                select(table)
+                out.append(f'import binary {self.importFile(data, True)}')
+                for k, c in enumerate(t.columns.values()):
+                    c.add([row[k] for row in rows])
+
+        for _ in range(steps):
+            if rng.random() < 0.35:
+                query(rng.choice(['read', 'sort', 'sorted', 'lookup', 'aggregate', 'distinct', 'quantile', 'sample']))
+            else:
+                mutate()
+        query(rng.choice(['read', 'sort', 'sorted']))
+        if not sent:
+            return out, sent
+        return ['open payload', 'open table'] + out + ['close table', 'close payload'], sent
+
+
+def run(binary, directory, program, flags):
+    with open(os.path.join(directory, 'program.db'), 'w') as f:
+        f.write('\n'.join(program) + '\n')
+    r = subprocess.run([binary, 'program.db'] + flags, cwd=directory, capture_output=True, text=True, timeout=120)
+    if r.returncode != 0 or 'ERROR' in r.stderr:
+        raise RuntimeError(f'exit {r.returncode}: {r.stderr.strip()}')
+
+
+def differential(binary, seed, cases):
+    for case in range(cases):
+        directory = tempfile.mkdtemp(prefix='nitro-test-')
+        try:
+            rng = random.Random(seed * 1000003 + case)
+            model = Model(rng, directory)
+            for p in range(rng.randint(1, 4)):
+                program, expected = model.program(rng.randint(5, 40))
+                flags = rng.choice(FLAGS)
+                out = os.path.join(directory, 'out.hex')
+                if os.path.exists(out):
+                    os.remove(out)
+                try:
+                    run(binary, directory, program, flags)
+                    got = sentColumns(out) if expected else []
+                except Exception as e:
+                    got = str(e)
+                if not matches(got, expected):
+                    print(f'FAIL seed {seed} case {case} program {p} flags {" ".join(flags)}')
+                    print('\n'.join(program))
+                    if isinstance(got, str):
+                        print(got)
+                    else:
+                        for k, (g, e) in enumerate(zip(got, expected)):
+                            if callable(e):
+                                if not e(g):
+                                    print(f'column {k} fails its check: got {g[:8]} of {len(g)} sent')
+                                    break
+                            elif g != e:
+                                at = next((i for i, (x, y) in enumerate(zip(g, e)) if x != y), min(len(g), len(e)))
+                                print(f'column {k} differs at {at} of {len(g)} sent, {len(e)} expected: got {g[at:at + 8]} expected {e[at:at + 8]}')
+                                break
+                        if len(got) != len(expected):
+                            print(f'sent {len(got)} columns, expected {len(expected)}')
+                    return False
+        finally:
+            shutil.rmtree(directory, ignore_errors=True)
+    print(f'differential: {cases} cases ok')
+    return True
+
+
+# rows per second every timed run must at least reach, about a quarter of what
+# one core manages so only a real regression trips them
+FLOORS = {
+    'ingest': 1_500_000,
+    'ingest indexed': 500_000,
+    'read sort send': 300_000,
+    'send sorted': 800_000,
+    'send sorted spilled': 600_000,
+}
+
+
+def performance(binary, rows):
+    directory = tempfile.mkdtemp(prefix='nitro-perf-')
+    try:
+        x = 88172645463325252
+        values = array.array('Q', [0]) * rows
+        for i in range(rows):
+            x ^= (x << 13) & (2**64 - 1)
+            x ^= x >> 7
+            x ^= (x << 17) & (2**64 - 1)
+            values[i] = x
+        expected = sorted(values)
+        with open(os.path.join(directory, 'values.bin'), 'wb') as f:
+            values.tofile(f)
+
+        ok = True
+
+        def timed(name, program, flags=[], check=None):
+            nonlocal ok
+            start = time.perf_counter()
+            run(binary, directory, program, flags)
+            seconds = time.perf_counter() - start
+            rate = rows / seconds
+            passed = rate >= FLOORS[name]
+            if check is not None:
+                columns = client.readColumnar(open(os.path.join(directory, 'out.hex'), 'rb').read())
+                passed &= list(columns[0]['values']) == check
+            ok &= passed
+            print(f'{name}: {rows} rows in {seconds:.2f}s, {rate / 1e6:.2f}M rows/s (floor {FLOORS[name] / 1e6:.2f}M) {"ok" if passed else "FAIL"}')
+
+        timed('ingest', ['create table p', 'select table p', 'create column v u64', 'import binary values.bin'])
+        timed('ingest indexed', ['create table q', 'select table q', 'create column v u64', 'select column v', 'create index', 'import binary values.bin'])
+        timed('read sort send', ['select table p', 'select column v', 'read', 'sort', 'send'], ['--columnar'], expected)
+        timed('send sorted', ['select table p', 'select column v', 'send sorted'], ['--columnar'], expected)
+        timed('send sorted spilled', ['select table p', 'select column v', 'send sorted'], ['--columnar', '--sort-mb', '2'], expected)
+        return ok
+    finally:
+        shutil.rmtree(directory, ignore_errors=True)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('binary')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--cases', type=int, default=200)
+    parser.add_argument('--rows', type=int, default=2_000_000)
+    parser.add_argument('--skip-perf', action='store_true')
+    args = parser.parse_args()
+    binary = os.path.abspath(args.binary)
+
+    ok = differential(binary, args.seed, args.cases)
+    if ok and not args.skip_perf:
+        ok = performance(binary, args.rows)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()